@@ -0,0 +1,89 @@
+/**************************************************************************
+ Runs display updates on a background thread with MAX3000_Engine, while
+ the main thread draws frames as fast as it can. Linux only.
+
+ Usage:
+     ./background_engine [priority] [cpu]
+
+ A non-zero priority runs the engine thread with SCHED_FIFO, and a cpu of
+ 0 or more pins it to that CPU. Both need the matching privileges (for
+ example, running as root). Frames drawn faster than the panels can flip
+ are replaced in the engine's slot, and only the latest one is shown.
+
+ Built against the display simulator when wiringPi isn't available.
+ **************************************************************************/
+
+#include <MAX3000_Engine.h>
+#include <MAX3000_Lib.h>
+#include <MAX3000_Sim.h>
+#include <stdio.h>
+
+#define DISPLAY_HEIGHT 32
+#define DISPLAY_WIDTH 84
+
+#define MAX_MOSI_PIN 12    // Pin connected to MTX_DIN
+#define MAX_SCLK_PIN 14    // Pin connected to MTX_CLK
+#define MAX_LAT_PIN 0      // Pin connected to MTX_LAT
+#define MAX_RST_PIN 2      // Pin connected to MTX_RST
+#define MAX_PULSE_PIN 3    // Pin connected to PULSE_ENABLE
+#define MAX_COL_PIN 25     // Pin connected to COL_ENABLE_N
+#define MAX_ROW_PIN 21     // Pin connected to ROW_ENABLE_N
+
+#define NUM_FRAMES 2000
+
+static std::atomic<uint32_t> shown(0);
+static std::atomic<uint32_t> replaced(0);
+
+int main(int argc, char ** argv) {
+    MAX3000_EngineOptions options;
+    options.priority = (argc > 1) ? atoi(argv[1]) : 0;
+    options.cpu      = (argc > 2) ? atoi(argv[2]) : -1;
+
+    wiringPiSetup();
+
+    MAX3000_Config config(DISPLAY_WIDTH, DISPLAY_HEIGHT,
+        MAX_MOSI_PIN, MAX_SCLK_PIN, MAX_LAT_PIN, MAX_RST_PIN,
+        MAX_PULSE_PIN, MAX_COL_PIN, MAX_ROW_PIN);
+#ifdef MAX3000_HOST_SIM
+    static MAX3000_SimTransport sim;
+    config.transport = &sim;
+#endif
+
+    MAX3000_Display display(config);
+    if(!display.begin()) {
+        printf("Display allocation failed\n");
+        return 1;
+    }
+
+    MAX3000_Engine engine(display);
+    engine.setCallback([](uint32_t frame, bool wasShown) {
+        (void)frame;
+        if(wasShown) {
+            shown++;
+        } else {
+            replaced++;
+        }
+    });
+    if(!engine.start(options)) {
+        printf("Engine failed to start with the requested scheduling options\n");
+        return 1;
+    }
+
+    // A bar sweeping across the display, redrawn every frame
+    std::future<bool> last;
+    for(int frame = 0; frame < NUM_FRAMES; ++frame) {
+        display.clearDisplay();
+        for(int16_t y = 0; y < display.height(); ++y) {
+            display.drawPixel(frame % display.width(), y, MAX3000_LIGHT);
+        }
+        last = engine.submit();
+    }
+
+    // The last frame is never replaced, so wait for it to be shown
+    bool lastShown = last.get();
+    engine.stop();
+
+    printf("Submitted %u frames: %u shown, %u replaced, last frame %s\n",
+        engine.getLastFrameNumber(), shown.load(), replaced.load(), lastShown ? "shown" : "not shown");
+    return 0;
+}
@@ -0,0 +1,747 @@
+/**************************************************************************
+ Benchmark of display() throughput against a simulated chain of MAX3000
+ drivers. Runs on a Linux host without any hardware attached.
+
+ Build with the CMake option MAX3000_SIMULATOR=ON, then run:
+     ./sim_benchmark [panels across] [panels down] [panel] [double]
+
+ The optional flags select the panel-major buffer layout and double
+ buffering.
+
+ Each scenario reports the modeled wall-clock cost of a display() call,
+ split into shifting, pulsing and other delays, and checks the simulated
+ dots against the frame buffer after every update. Exits with 1 if any
+ dot didn't match or any fault was modeled. The checks of each feature,
+ with every board order and orientation, are in tests/sim_test.cpp.
+ **************************************************************************/
+
+#include <MAX3000_Lib.h>
+#include <MAX3000_Scheduler.h>
+#include <MAX3000_Sim.h>
+#include <MAX3000_Static.h>
+#include <MAX3000_Stream.h>
+#include <MAX3000_Wall.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_PANELS_ACROSS 5
+#define DEFAULT_PANELS_DOWN 4
+
+static MAX3000_SimTransport sim;
+static MAX3000_Display * display;
+
+// Mismatched dots and faults of all scenarios
+static size_t failures = 0;
+
+/**
+ * Counts dots on the simulated chain that don't match the frame buffer.
+ */
+static size_t countMismatches(const MAX3000_Config & config) {
+    size_t mismatches = 0;
+    for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
+        size_t originX = (board % config.numHBoards) * PANEL_WIDTH;
+        size_t originY = (board / config.numHBoards) * PANEL_HEIGHT;
+        for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+            for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+                if(sim.getDot(board, row, col) != display->getPixel(originX + col, originY + row)) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+/**
+ * Runs a number of frames, drawing each one with the given function.
+ */
+static void runScenario(const char * name, const MAX3000_Config & config, int frames,
+    void (*draw)(int frame)) {
+    sim.resetStats();
+
+    size_t mismatches    = 0;
+    uint64_t worstNs     = 0;
+    uint64_t estimatedUs = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        draw(frame);
+        MAX3000_TimeEstimate estimate;
+        display->estimateDisplayTime(estimate);
+        estimatedUs += estimate.totalUs;
+        display->display();
+        mismatches += countMismatches(config);
+        if(sim.getFrameStats().totalNs > worstNs) {
+            worstNs = sim.getFrameStats().totalNs;
+        }
+    }
+
+    const MAX3000_SimStats & stats = sim.getTotalStats();
+    printf("%-10s %6d %10.2f %10.2f %10.2f %10.2f %10.2f %9.1f %9.1f %8.1f %7.1f %6u %8zu\n",
+        name, frames,
+        stats.totalNs / 1e6 / frames,
+        estimatedUs / 1e3 / frames,
+        worstNs / 1e6,
+        stats.shiftNs / 1e6 / frames,
+        (stats.pulseNs + stats.delayNs) / 1e6 / frames,
+        (double)stats.pulses / frames,
+        (double)stats.flips / frames,
+        stats.hostNs / 1e3 / frames,
+        stats.longestPulseNs / 1e3,
+        stats.faults,
+        mismatches);
+    failures += mismatches + stats.faults;
+}
+
+/**
+ * Runs a number of frames through displayBegin() and displayStep(), and
+ * reports how the updates were split into steps.
+ */
+static void runStepped(const char * name, const MAX3000_Config & config, int frames,
+    void (*draw)(int frame), uint32_t budgetUs) {
+    sim.resetStats();
+
+    size_t mismatches  = 0;
+    size_t steps       = 0;
+    uint64_t worstStep = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        draw(frame);
+        display->displayBegin();
+        while(display->isDisplayBusy()) {
+            uint64_t stepStart = sim.getNowNs();
+            display->displayStep(budgetUs);
+            if(sim.getNowNs() - stepStart > worstStep) {
+                worstStep = sim.getNowNs() - stepStart;
+            }
+            steps++;
+        }
+        mismatches += countMismatches(config);
+    }
+
+    const MAX3000_SimStats & stats = sim.getTotalStats();
+    printf("%-10s %6d %10.2f %10.1f %10.1f %8zu\n",
+        name, frames,
+        stats.totalNs / 1e6 / frames,
+        (double)steps / frames,
+        worstStep / 1e3,
+        mismatches);
+    failures += mismatches + stats.faults;
+}
+
+/**
+ * Draws a new frame after every displayStep(), so each frame replaces the
+ * target of the update in progress, and reports the flips this saves.
+ */
+static void runCoalesced(const char * name, const MAX3000_Config & config, int frames,
+    void (*draw)(int frame), uint32_t budgetUs) {
+    sim.resetStats();
+
+    for(int frame = 0; frame < frames; ++frame) {
+        draw(frame);
+        display->displayBegin();
+        display->displayStep(budgetUs);
+    }
+    while(display->displayStep(budgetUs)) {
+    }
+    size_t mismatches = countMismatches(config);
+
+    const MAX3000_SimStats & stats = sim.getTotalStats();
+    printf("%-10s %6d %10.2f %9.1f %9.1f %8zu\n",
+        name, frames,
+        stats.totalNs / 1e6 / frames,
+        (double)stats.pulses / frames,
+        (double)stats.flips / frames,
+        mismatches);
+    failures += mismatches + stats.faults;
+}
+
+/**
+ * Runs a number of frames with updates paced to a fixed period, and
+ * reports the spread of the intervals between update starts.
+ */
+static void runPaced(const char * name, const MAX3000_Config & config, int frames,
+    void (*draw)(int frame), uint32_t periodUs) {
+    sim.resetStats();
+    display->setFramePeriodUs(periodUs);
+
+    size_t mismatches   = 0;
+    uint64_t busyNs     = 0;
+    uint64_t lastStart  = 0;
+    uint64_t shortestNs = UINT64_MAX;
+    uint64_t longestNs  = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        draw(frame);
+        display->display();
+        mismatches += countMismatches(config);
+        busyNs += sim.getFrameStats().totalNs;
+
+        // Nothing runs between the end of the update and display() returning
+        uint64_t start = sim.getNowNs() - sim.getFrameStats().totalNs;
+        if(frame > 0) {
+            shortestNs = (start - lastStart < shortestNs) ? start - lastStart : shortestNs;
+            longestNs  = (start - lastStart > longestNs) ? start - lastStart : longestNs;
+        }
+        lastStart = start;
+    }
+    display->setFramePeriodUs(0);
+
+    printf("%-10s %6d %10.2f %10.3f %10.3f %8zu\n",
+        name, frames,
+        busyNs / 1e6 / frames,
+        shortestNs / 1e6,
+        longestNs / 1e6,
+        mismatches);
+    failures += mismatches + sim.getTotalStats().faults;
+}
+
+/**
+ * Cycles through a few slides, and reports the host time spent in each
+ * display() call, with or without a plan cache.
+ */
+static void runSlides(const char * name, const MAX3000_Config & config, int frames,
+    void (*draw)(int frame), MAX3000_PlanCache * cache) {
+    display->setPlanCache(cache);
+    sim.resetStats();
+
+    size_t mismatches = 0;
+    uint64_t hostNs   = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        draw(frame);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        display->display();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        hostNs += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+        mismatches += countMismatches(config);
+    }
+    display->setPlanCache(NULL);
+
+    const MAX3000_SimStats & stats = sim.getTotalStats();
+    printf("%-10s %6d %10.2f %9.1f %8.1f %6u %8zu\n",
+        name, frames,
+        stats.totalNs / 1e6 / frames,
+        (double)stats.pulses / frames,
+        hostNs / 1e3 / frames,
+        cache ? cache->getHits() : 0,
+        mismatches);
+    failures += mismatches + stats.faults;
+}
+
+/**
+ * Splits the wall into chains of whole rows of panels, updated concurrently
+ * by a MAX3000_Wall, and reports the slowest chain of each update.
+ */
+static void runChains(const MAX3000_Config & config, size_t numChains, int frames) {
+    size_t chainHeight = config.height / numChains;
+    MAX3000_Wall wall(config.width, config.height);
+    MAX3000_SimTransport * sims = new MAX3000_SimTransport[numChains];
+    MAX3000_Display ** chains   = new MAX3000_Display *[numChains];
+    for(size_t i = 0; i < numChains; ++i) {
+        MAX3000_Config chainConfig(config.width, chainHeight, 0, 1, 2, 3, 4, 5, 6);
+        chainConfig.transport = &sims[i];
+        chains[i]             = new MAX3000_Display(chainConfig);
+        chains[i]->begin();
+        wall.addChain(*chains[i], 0, i * chainHeight);
+    }
+    wall.start();
+
+    size_t mismatches = 0;
+    uint64_t totalUs  = 0;
+    uint64_t shiftNs  = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        // The slide patterns of drawSlides, drawn into the wall's buffer
+        int slide = frame % 4;
+        for(int16_t x = 0; x < wall.width(); ++x) {
+            for(int16_t y = 0; y < wall.height(); ++y) {
+                bool on = ((x * (slide + 1) + y * (slide + 3)) % 7) < 3;
+                wall.drawPixel(x, y, on ? MAX3000_LIGHT : MAX3000_DARK);
+            }
+        }
+        wall.display();
+        totalUs += wall.getLastDisplayUs();
+
+        uint64_t longestShiftNs = 0;
+        for(size_t i = 0; i < numChains; ++i) {
+            if(sims[i].getFrameStats().shiftNs > longestShiftNs) {
+                longestShiftNs = sims[i].getFrameStats().shiftNs;
+            }
+            for(size_t board = 0; board < sims[i].getNumBoards(); ++board) {
+                size_t originX = (board % config.numHBoards) * PANEL_WIDTH;
+                size_t originY = i * chainHeight + (board / config.numHBoards) * PANEL_HEIGHT;
+                for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+                    for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+                        if(sims[i].getDot(board, row, col) != wall.getPixel(originX + col, originY + row)) {
+                            mismatches++;
+                        }
+                    }
+                }
+            }
+        }
+        shiftNs += longestShiftNs;
+    }
+    wall.stop();
+
+    uint32_t worstUs = 0;
+    for(size_t i = 0; i < numChains; ++i) {
+        if(wall.getChainTiming(i).worstUs > worstUs) {
+            worstUs = wall.getChainTiming(i).worstUs;
+        }
+    }
+    printf("%6zu %6zu %6d %10.2f %10.2f %10.2f %8zu\n",
+        numChains, config.numHBoards * config.numVBoards / numChains, frames,
+        totalUs / 1e3 / frames,
+        worstUs / 1e3,
+        shiftNs / 1e6 / frames,
+        mismatches);
+    failures += mismatches;
+    for(size_t i = 0; i < numChains; ++i) {
+        failures += sims[i].getTotalStats().faults;
+    }
+
+    for(size_t i = 0; i < numChains; ++i) {
+        delete chains[i];
+    }
+    delete[] chains;
+    delete[] sims;
+}
+
+/**
+ * Updates two displays on separate pins from one CPU, one after the other
+ * or interleaved by a MAX3000_Scheduler, and reports the time of both.
+ */
+static void runTwoDisplays(const char * name, const MAX3000_Config & config, int frames, bool interleaved,
+    const MAX3000_SimTiming & timing) {
+    MAX3000_SimTransport first(timing), second(timing);
+    MAX3000_SimTransport * sims[2] = { &first, &second };
+    second.shareClock(first);
+    MAX3000_Display * displays[2];
+    MAX3000_Scheduler scheduler;
+    for(size_t i = 0; i < 2; ++i) {
+        MAX3000_Config displayConfig(config.width, config.height, 0, 1, 2, 3, 4, 5, 6);
+        displayConfig.transport = sims[i];
+        displays[i]             = new MAX3000_Display(displayConfig);
+        displays[i]->begin();
+        scheduler.add(*displays[i]);
+    }
+
+    size_t mismatches  = 0;
+    uint64_t elapsedNs = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        // Each display cycles through the slide patterns of drawSlides, half a cycle apart
+        for(size_t i = 0; i < 2; ++i) {
+            int slide = (frame + 2 * i) % 4;
+            for(int16_t x = 0; x < displays[i]->width(); ++x) {
+                for(int16_t y = 0; y < displays[i]->height(); ++y) {
+                    bool on = ((x * (slide + 1) + y * (slide + 3)) % 7) < 3;
+                    displays[i]->drawPixel(x, y, on ? MAX3000_LIGHT : MAX3000_DARK);
+                }
+            }
+        }
+
+        uint64_t start = first.getNowNs();
+        if(interleaved) {
+            scheduler.display();
+        } else {
+            displays[0]->display();
+            displays[1]->display();
+        }
+        elapsedNs += first.getNowNs() - start;
+
+        for(size_t i = 0; i < 2; ++i) {
+            for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
+                size_t originX = (board % config.numHBoards) * PANEL_WIDTH;
+                size_t originY = (board / config.numHBoards) * PANEL_HEIGHT;
+                for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+                    for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+                        if(sims[i]->getDot(board, row, col) != displays[i]->getPixel(originX + col, originY + row)) {
+                            mismatches++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const MAX3000_SimStats & a = first.getTotalStats();
+    const MAX3000_SimStats & b = second.getTotalStats();
+    printf("%-16s %6d %10.2f %9.1f %7.1f %6u %8zu\n",
+        name, frames,
+        elapsedNs / 1e6 / frames,
+        (double)(a.pulses + b.pulses) / frames,
+        ((a.longestPulseNs > b.longestPulseNs) ? a.longestPulseNs : b.longestPulseNs) / 1e3,
+        a.faults + b.faults,
+        mismatches);
+    failures += mismatches + a.faults + b.faults;
+
+    for(size_t i = 0; i < 2; ++i) {
+        delete displays[i];
+    }
+}
+
+/**
+ * Times drawing whole frames pixel by pixel into a display sized at
+ * runtime and into one sized at compile time, and compares their buffers.
+ */
+static void runStaticDrawing(int frames) {
+    typedef MAX3000_Static<DEFAULT_PANELS_ACROSS * PANEL_WIDTH, DEFAULT_PANELS_DOWN * PANEL_HEIGHT,
+        MAX3000_ORDER_ROW_MAJOR_BOUNCE, MAX3000_LAYOUT_PANEL>
+        StaticDisplay;
+    MAX3000_SimTransport runtimeSim, staticSim;
+    MAX3000_Config runtimeConfig(StaticDisplay::WIDTH, StaticDisplay::HEIGHT, 0, 1, 2, 3, 4, 5, 6);
+    runtimeConfig.boardOrder   = MAX3000_ORDER_ROW_MAJOR_BOUNCE;
+    runtimeConfig.bufferLayout = MAX3000_LAYOUT_PANEL;
+    runtimeConfig.transport    = &runtimeSim;
+    MAX3000_Display runtimeDisplay(runtimeConfig);
+    StaticDisplay * staticDisplay = new StaticDisplay(staticSim);
+    runtimeDisplay.begin();
+    staticDisplay->begin();
+
+    MAX3000_Display * displays[2] = { &runtimeDisplay, staticDisplay };
+    double elapsedNs[2];
+    for(size_t i = 0; i < 2; ++i) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int frame = 0; frame < frames; ++frame) {
+            for(int16_t x = 0; x < displays[i]->width(); ++x) {
+                for(int16_t y = 0; y < displays[i]->height(); ++y) {
+                    bool on = ((x * (frame + 1) + y * (frame + 3)) % 7) < 3;
+                    displays[i]->drawPixel(x, y, on ? MAX3000_LIGHT : MAX3000_DARK);
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsedNs[i] = (end.tv_sec - start.tv_sec) * 1e9 + end.tv_nsec - start.tv_nsec;
+    }
+
+    static const char * names[2] = { "runtime", "static" };
+    bool mismatch = memcmp(runtimeDisplay.getBuffer(), staticDisplay->getBuffer(), StaticDisplay::BUFFER_BYTES) != 0;
+    for(size_t i = 0; i < 2; ++i) {
+        printf("%-10s %6d %10.2f %10.2f %8d\n", names[i], frames, elapsedNs[i] / 1e3 / frames,
+            elapsedNs[i] / ((double)frames * StaticDisplay::WIDTH * StaticDisplay::HEIGHT), mismatch ? 1 : 0);
+    }
+    failures += mismatch ? 1 : 0;
+    delete staticDisplay;
+}
+
+/**
+ * Renders a panel of the main display's frame buffer into a tile.
+ */
+static void renderTile(uint16_t panelX, uint16_t panelY, uint8_t * tile, void * context) {
+    (void)context;
+    memset(tile, 0, PANEL_PENDING_BYTES);
+    for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+        for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+            if(display->getPixel(panelX * PANEL_WIDTH + col, panelY * PANEL_HEIGHT + row)) {
+                tile[col + (row / 8) * PANEL_WIDTH] |= 1 << (row & 7);
+            }
+        }
+    }
+}
+
+/**
+ * Streams the frames drawn into the main display through a MAX3000_Stream on
+ * its own simulated chain, and reports the memory kept for the panels.
+ */
+static void runStreamed(const char * name, const MAX3000_Config & config, int frames,
+    void (*draw)(int frame), uint8_t store, uint8_t tilesAtOnce) {
+    MAX3000_SimTransport streamSim;
+    MAX3000_Config streamConfig = config;
+    streamConfig.transport      = &streamSim;
+    MAX3000_Stream stream(streamConfig, renderTile, NULL, store, tilesAtOnce);
+    stream.begin();
+    stream.display();
+    streamSim.resetStats();
+
+    size_t numBoards  = config.numHBoards * config.numVBoards;
+    size_t mismatches = 0;
+    size_t skipped    = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        draw(frame);
+        stream.display();
+        skipped += stream.getSkippedPanels();
+        for(size_t board = 0; board < numBoards; ++board) {
+            size_t originX = (board % config.numHBoards) * PANEL_WIDTH;
+            size_t originY = (board / config.numHBoards) * PANEL_HEIGHT;
+            for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+                for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+                    if(streamSim.getDot(board, row, col) != display->getPixel(originX + col, originY + row)) {
+                        mismatches++;
+                    }
+                }
+            }
+        }
+    }
+
+    size_t recordBytes = numBoards * ((store == MAX3000_STREAM_HASH) ? 4 : PANEL_PENDING_BYTES);
+    const MAX3000_SimStats & stats = streamSim.getTotalStats();
+    printf("%-10s %5u %6d %10.2f %9.1f %8.1f %8zu %8zu\n",
+        name, tilesAtOnce, frames,
+        stats.totalNs / 1e6 / frames,
+        (double)stats.pulses / frames,
+        (double)skipped / frames,
+        recordBytes + tilesAtOnce * PANEL_PENDING_BYTES,
+        mismatches);
+    failures += mismatches + stats.faults;
+}
+
+/**
+ * Shows the frames drawn into the main display on a chain over hardware SPI,
+ * whose dots flip in 100 us except for one slow bank of the first panel,
+ * with a single pulse duration or a calibration map. Pulses too short for
+ * the slow bank leave dots unflipped, which only counts as a failure when
+ * the pulses should flip every dot.
+ */
+static void runCalibrated(const char * name, const MAX3000_Config & config, int frames,
+    void (*draw)(int frame), uint16_t durationUs, const MAX3000_Calibration * calibration, bool flipsAll) {
+    MAX3000_SimTiming timing;
+    timing.spiWordNs = 2000;
+    MAX3000_SimTransport calSim(timing);
+    MAX3000_Config calConfig = config;
+    calConfig.transport      = &calSim;
+    MAX3000_Display calDisplay(calConfig);
+    calDisplay.begin();
+    calSim.setFlipThresholdUs(100);
+    calSim.setFlipThresholdUs(0, 1, 0, 240);
+    calDisplay.setPulseDurationUs(durationUs);
+    calDisplay.setCalibration(calibration);
+    calDisplay.display();
+    calSim.resetStats();
+
+    size_t numBoards  = config.numHBoards * config.numVBoards;
+    size_t mismatches = 0;
+    for(int frame = 0; frame < frames; ++frame) {
+        draw(frame);
+        memcpy(calDisplay.getBuffer(), display->getBuffer(), config.width * ((config.height + 7) / 8));
+        calDisplay.display();
+        for(size_t board = 0; board < numBoards; ++board) {
+            size_t originX = (board % config.numHBoards) * PANEL_WIDTH;
+            size_t originY = (board / config.numHBoards) * PANEL_HEIGHT;
+            for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+                for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+                    if(calSim.getDot(board, row, col) != display->getPixel(originX + col, originY + row)) {
+                        mismatches++;
+                    }
+                }
+            }
+        }
+    }
+
+    const MAX3000_SimStats & stats = calSim.getTotalStats();
+    printf("%-10s %6d %10.2f %9.1f %9.1f %8zu\n",
+        name, frames,
+        stats.totalNs / 1e6 / frames,
+        (double)stats.pulses / frames,
+        (double)stats.weakPulses / frames,
+        mismatches);
+    failures += (flipsAll ? mismatches : 0) + stats.faults;
+}
+
+static void drawFull(int frame) {
+    display->clearDisplay();
+    for(int16_t x = 0; x < display->width(); ++x) {
+        for(int16_t y = 0; y < display->height(); ++y) {
+            display->drawPixel(x, y, ((x + y + frame) & 1) ? MAX3000_LIGHT : MAX3000_DARK);
+        }
+    }
+}
+
+static void drawTicker(int frame) {
+    // Scrolling stripes on the first panel, everything else static
+    for(int16_t x = 0; x < PANEL_WIDTH; ++x) {
+        for(int16_t y = 0; y < PANEL_HEIGHT; ++y) {
+            display->drawPixel(x, y, (((x + frame) / 3) & 1) ? MAX3000_LIGHT : MAX3000_DARK);
+        }
+    }
+}
+
+static void drawDigits(int frame) {
+    // Three 3x5 blocks in the middle of the wall change each frame
+    int16_t cx = display->width() / 2 - 6;
+    int16_t cy = display->height() / 2 - 2;
+    for(int digit = 0; digit < 3; ++digit) {
+        for(int16_t x = 0; x < 3; ++x) {
+            for(int16_t y = 0; y < 5; ++y) {
+                bool on = ((x * 5 + y + frame * (digit + 1)) % 3) == 0;
+                display->drawPixel(cx + digit * 4 + x, cy + y, on ? MAX3000_LIGHT : MAX3000_DARK);
+            }
+        }
+    }
+}
+
+static void drawScatter(int frame) {
+    // A few pixels change on every panel, each at a different position
+    for(int16_t px = 0; px < display->width() / PANEL_WIDTH; ++px) {
+        for(int16_t py = 0; py < display->height() / PANEL_HEIGHT; ++py) {
+            int16_t x = px * PANEL_WIDTH + (px * 7 + py * 3 + frame) % PANEL_WIDTH;
+            int16_t y = py * PANEL_HEIGHT + (px * 5 + py * 11) % PANEL_HEIGHT;
+            display->drawPixel(x, y, MAX3000_INVERSE);
+            display->drawPixel(x, (y + 8) % PANEL_HEIGHT + py * PANEL_HEIGHT, MAX3000_INVERSE);
+        }
+    }
+}
+
+static void drawSlides(int frame) {
+    // Four full-wall patterns shown in turn, like signage cycling through slides
+    int slide = frame % 4;
+    for(int16_t x = 0; x < display->width(); ++x) {
+        for(int16_t y = 0; y < display->height(); ++y) {
+            bool on = ((x * (slide + 1) + y * (slide + 3)) % 7) < 3;
+            display->drawPixel(x, y, on ? MAX3000_LIGHT : MAX3000_DARK);
+        }
+    }
+}
+
+static void drawNothing(int frame) {
+    (void)frame;
+}
+
+int main(int argc, char ** argv) {
+    int across = (argc > 1) ? atoi(argv[1]) : DEFAULT_PANELS_ACROSS;
+    int down   = (argc > 2) ? atoi(argv[2]) : DEFAULT_PANELS_DOWN;
+
+    MAX3000_Config config(across * PANEL_WIDTH, down * PANEL_HEIGHT, 0, 1, 2, 3, 4, 5, 6);
+    config.transport = &sim;
+    for(int arg = 3; arg < argc; ++arg) {
+        if(!strcmp(argv[arg], "panel")) {
+            config.bufferLayout = MAX3000_LAYOUT_PANEL;
+        } else if(!strcmp(argv[arg], "double")) {
+            config.bufferMode = MAX3000_BUFFER_DOUBLE;
+        }
+    }
+
+    display = new MAX3000_Display(config);
+    if(!display->begin()) {
+        printf("Display allocation failed\n");
+        return 1;
+    }
+
+    printf("Simulated wall: %d x %d panels, pulse %u us, %s layout, %s buffered\n\n", across, down, 250,
+        (config.bufferLayout == MAX3000_LAYOUT_PANEL) ? "panel" : "paged",
+        (config.bufferMode == MAX3000_BUFFER_DOUBLE) ? "double" : "single");
+    printf("%-10s %6s %10s %10s %10s %10s %10s %9s %9s %8s %7s %6s %8s\n",
+        "scenario", "frames", "avg ms", "est ms", "worst ms", "shift ms", "wait ms",
+        "pulses", "flips", "host us", "max pw", "faults", "mismatch");
+
+    runScenario("first", config, 1, drawNothing);
+    runScenario("full", config, 4, drawFull);
+    display->clearDisplay();
+    display->display();
+    runScenario("ticker", config, 16, drawTicker);
+    runScenario("digits", config, 16, drawDigits);
+    runScenario("scatter", config, 16, drawScatter);
+    runScenario("static", config, 16, drawNothing);
+
+    // Start each scenario from the same dots as with separate pulses
+    printf("\nCombined set/clear pulses:\n");
+    display->setPulseMode(MAX3000_PULSE_COMBINED);
+    display->clearDisplay();
+    display->display();
+    runScenario("full", config, 4, drawFull);
+    display->clearDisplay();
+    display->display();
+    runScenario("ticker", config, 16, drawTicker);
+    runScenario("digits", config, 16, drawDigits);
+    runScenario("scatter", config, 16, drawScatter);
+
+    printf("\nStepped updates, %u us budget:\n", 20000);
+    printf("%-10s %6s %10s %10s %10s %8s\n",
+        "scenario", "frames", "avg ms", "steps", "worst us", "mismatch");
+    display->setPulseMode(MAX3000_PULSE_SEPARATE);
+    runStepped("full", config, 4, drawFull, 20000);
+    runStepped("digits", config, 16, drawDigits, 20000);
+
+    printf("\nNew frame after each %u us step:\n", 20000);
+    printf("%-10s %6s %10s %9s %9s %8s\n",
+        "scenario", "frames", "avg ms", "pulses", "flips", "mismatch");
+    runCoalesced("ticker", config, 16, drawTicker, 20000);
+    runCoalesced("digits", config, 16, drawDigits, 20000);
+
+    printf("\nUpdates paced to a %u ms period:\n", 2000);
+    printf("%-10s %6s %10s %10s %10s %8s\n",
+        "scenario", "frames", "busy ms", "min ms", "max ms", "mismatch");
+    runPaced("ticker", config, 16, drawTicker, 2000000);
+    runPaced("digits", config, 16, drawDigits, 2000000);
+
+    printf("\nTransitions between slides by scan order:\n");
+    static const char * scanNames[] = { "sequential", "wipe right", "wipe left", "wipe down", "wipe up",
+        "spiral", "center out", "diagonal", "text" };
+    for(uint8_t scan = MAX3000_SCAN_SEQUENTIAL; scan <= MAX3000_SCAN_TEXT; ++scan) {
+        display->setScanOrder(scan);
+        runScenario(scanNames[scan], config, 4, drawSlides);
+    }
+    display->setScanOrder((uint8_t)MAX3000_SCAN_SEQUENTIAL);
+
+    printf("\nCycling through %d slides:\n", 4);
+    printf("%-10s %6s %10s %9s %8s %6s %8s\n",
+        "scenario", "frames", "avg ms", "pulses", "host us", "hits", "mismatch");
+    MAX3000_PlanCache cache(4);
+    runSlides("uncached", config, 16, drawSlides, NULL);
+    runSlides("cached", config, 16, drawSlides, &cache);
+
+    // A plan gives the pulse count of an update before it is sent, and
+    // shows the host time of comparing and scheduling alone
+    MAX3000_Plan plan;
+    drawSlides(1);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool planned = display->plan(plan);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if(planned && display->execute(plan)) {
+        size_t mismatches = countMismatches(config);
+        printf("%-10s %6d %10.2f %9zu %8.1f %6s %8zu\n", "planned", 1, sim.getFrameStats().totalNs / 1e6,
+            plan.getPulseCount(), ((end.tv_sec - start.tv_sec) * 1e9 + end.tv_nsec - start.tv_nsec) / 1e3, "-",
+            mismatches);
+        failures += mismatches;
+    } else {
+        printf("Planning failed\n");
+        failures++;
+    }
+
+    printf("\nTwo displays on separate pins, driven from one CPU:\n");
+    printf("%-16s %6s %10s %9s %7s %6s %8s\n",
+        "scenario", "frames", "avg ms", "pulses", "max pw", "faults", "mismatch");
+    MAX3000_SimTiming bitBanged, spi;
+    spi.spiWordNs = 2000;
+    runTwoDisplays("serial", config, 4, false, bitBanged);
+    runTwoDisplays("interleaved", config, 4, true, bitBanged);
+    runTwoDisplays("serial spi", config, 4, false, spi);
+    runTwoDisplays("interleaved spi", config, 4, true, spi);
+
+    printf("\nWall split into chains of whole panel rows:\n");
+    printf("%6s %6s %6s %10s %10s %10s %8s\n",
+        "chains", "boards", "frames", "avg ms", "worst ms", "shift ms", "mismatch");
+    for(size_t numChains = 1; numChains <= config.numVBoards; numChains *= 2) {
+        if(config.numVBoards % numChains == 0) {
+            runChains(config, numChains, 4);
+        }
+    }
+
+    printf("\nStreamed one group of panels at a time, no frame buffer:\n");
+    printf("%-10s %5s %6s %10s %9s %8s %8s %8s\n",
+        "store", "tiles", "frames", "avg ms", "pulses", "skipped", "bytes", "mismatch");
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    runStreamed("state", config, 16, drawDigits, MAX3000_STREAM_STATE, 1);
+    runStreamed("state", config, 16, drawDigits, MAX3000_STREAM_STATE, numBoards);
+    runStreamed("hash", config, 16, drawDigits, MAX3000_STREAM_HASH, 1);
+    runStreamed("hash", config, 16, drawDigits, MAX3000_STREAM_HASH, numBoards);
+
+    printf("\nPulse durations over SPI, dots flipping in 100 us but one slow bank:\n");
+    printf("%-10s %6s %10s %9s %9s %8s\n",
+        "pulses", "frames", "avg ms", "pulses", "weak", "mismatch");
+    MAX3000_Calibration calibration;
+    calibration.begin(numBoards, 100);
+    calibration.setBankDurationUs(0, 1, 0, 240);
+    runCalibrated("250 us", config, 4, drawSlides, 250, NULL, true);
+    runCalibrated("100 us", config, 4, drawSlides, 100, NULL, false);
+    runCalibrated("map", config, 4, drawSlides, 250, &calibration, true);
+
+    printf("\nDrawing into a %d x %d panel display, host time:\n", DEFAULT_PANELS_ACROSS, DEFAULT_PANELS_DOWN);
+    printf("%-10s %6s %10s %10s %8s\n", "display", "frames", "frame us", "pixel ns", "mismatch");
+    runStaticDrawing(64);
+
+    delete display;
+    if(failures) {
+        printf("\n%zu mismatched dots and faults\n", failures);
+        return 1;
+    }
+    return 0;
+}
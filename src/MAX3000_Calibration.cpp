@@ -0,0 +1,213 @@
+/**
+ * @file MAX3000_Calibration.cpp
+ *
+ * Pulse durations calibrated per board and per decoder bank.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#include <MAX3000_Calibration.h>
+#include <MAX3000_Plan.h>
+
+#ifdef WIRINGPI
+#include <atomic>
+#endif
+
+#define BLOB_HEADER_SIZE 7    // Magic, version, number of boards and number of classes
+#define BLOB_HASH_SIZE 4      // Trailing hash of the blob
+
+// Last generation given to any map, so generations identify the contents of all maps.
+// Hosted builds change maps from the threads of MAX3000_Engine and MAX3000_Wall.
+#ifdef WIRINGPI
+static std::atomic<uint32_t> lastGeneration(0);
+#else
+static uint32_t lastGeneration = 0;
+#endif
+
+MAX3000_Calibration::MAX3000_Calibration(void)
+    : classes(NULL),
+      numBoards(0),
+      numClasses(0),
+      generation(0) {
+    memset(durations, 0, sizeof(durations));
+    nextGeneration();
+}
+
+MAX3000_Calibration::~MAX3000_Calibration(void) {
+    delete[] classes;
+}
+
+bool MAX3000_Calibration::begin(size_t numBoards_, uint16_t durationUs) {
+    if(numBoards_ != numBoards) {
+        delete[] classes;
+        classes   = NULL;
+        numBoards = 0;
+    }
+    if((!classes) && !(classes = new uint8_t[numBoards_ * 4])) {
+        return false;
+    }
+    numBoards = numBoards_;
+
+    // Every bank starts in the single class
+    memset(classes, 0, numBoards * 4);
+    memset(durations, 0, sizeof(durations));
+    durations[0] = durationUs;
+    numClasses   = 1;
+    nextGeneration();
+    return true;
+}
+
+bool MAX3000_Calibration::setBoardDurationUs(size_t board, uint16_t durationUs) {
+    if(board >= numBoards) {
+        return false;
+    }
+
+    uint8_t durationClass = findClass(durationUs);
+    if(durationClass == MAX3000_CALIBRATION_CLASSES) {
+        return false;
+    }
+    memset(&classes[board * 4], durationClass | (durationClass << 4), 4);
+    nextGeneration();
+    return true;
+}
+
+bool MAX3000_Calibration::setBankDurationUs(size_t board, uint8_t colBank, uint8_t rowBank, uint16_t durationUs) {
+    if(board >= numBoards || colBank > 3 || rowBank > 1) {
+        return false;
+    }
+
+    uint8_t durationClass = findClass(durationUs);
+    if(durationClass == MAX3000_CALIBRATION_CLASSES) {
+        return false;
+    }
+    setClass(board, MAX3000_CALIBRATION_BANK(colBank, rowBank), durationClass);
+    nextGeneration();
+    return true;
+}
+
+uint16_t MAX3000_Calibration::getBankDurationUs(size_t board, uint8_t colBank, uint8_t rowBank) const {
+    if(board >= numBoards || colBank > 3 || rowBank > 1) {
+        return 0;
+    }
+    return durations[getClass(board, MAX3000_CALIBRATION_BANK(colBank, rowBank))];
+}
+
+uint8_t MAX3000_Calibration::findClass(uint16_t durationUs) {
+    for(uint8_t durationClass = 0; durationClass < numClasses; ++durationClass) {
+        if(durations[durationClass] == durationUs) {
+            return durationClass;
+        }
+    }
+
+    // Find which classes are still in use, so a free slot can be taken
+    // before the map runs out of classes.
+    uint16_t used = 0;
+    for(size_t board = 0; board < numBoards; ++board) {
+        for(uint8_t bank = 0; bank < MAX3000_CALIBRATION_BANKS; ++bank) {
+            used |= 1 << getClass(board, bank);
+        }
+    }
+    for(uint8_t durationClass = 0; durationClass < numClasses; ++durationClass) {
+        if(!(used & (1 << durationClass))) {
+            durations[durationClass] = durationUs;
+            return durationClass;
+        }
+    }
+
+    if(numClasses == MAX3000_CALIBRATION_CLASSES) {
+        return MAX3000_CALIBRATION_CLASSES;
+    }
+    durations[numClasses] = durationUs;
+    return numClasses++;
+}
+
+void MAX3000_Calibration::setClass(size_t board, uint8_t bank, uint8_t durationClass) {
+    uint8_t & pair = classes[board * 4 + (bank >> 1)];
+    uint8_t shift  = (bank & 1) * 4;
+    pair           = (pair & ~(0xF << shift)) | (durationClass << shift);
+}
+
+void MAX3000_Calibration::nextGeneration(void) {
+    // 0 stands for no calibration
+    uint32_t next = ++lastGeneration;
+    if(!next) {
+        next = ++lastGeneration;
+    }
+    generation = next;
+}
+
+size_t MAX3000_Calibration::getBlobSize(void) const {
+    return BLOB_HEADER_SIZE + numClasses * 2 + numBoards * 4 + BLOB_HASH_SIZE;
+}
+
+size_t MAX3000_Calibration::save(uint8_t * blob, size_t size) const {
+    size_t length = getBlobSize();
+    if(!classes || size < length) {
+        return 0;
+    }
+
+    // Multi-byte fields are written a byte at a time, so the blob is the
+    // same on little and big-endian platforms.
+    uint8_t * out = blob;
+    *out++        = 'M';
+    *out++        = '3';
+    *out++        = 'C';
+    *out++        = MAX3000_CALIBRATION_VERSION;
+    *out++        = numBoards & 0xFF;
+    *out++        = (numBoards >> 8) & 0xFF;
+    *out++        = numClasses;
+    for(uint8_t durationClass = 0; durationClass < numClasses; ++durationClass) {
+        *out++ = durations[durationClass] & 0xFF;
+        *out++ = durations[durationClass] >> 8;
+    }
+    memcpy(out, classes, numBoards * 4);
+    out += numBoards * 4;
+
+    uint32_t hash = MAX3000_Plan::hash(blob, out - blob);
+    for(uint8_t i = 0; i < BLOB_HASH_SIZE; ++i) {
+        *out++ = (hash >> (i * 8)) & 0xFF;
+    }
+    return length;
+}
+
+bool MAX3000_Calibration::load(const uint8_t * blob, size_t size) {
+    // Check the whole blob before touching the map
+    if(size < BLOB_HEADER_SIZE + BLOB_HASH_SIZE || blob[0] != 'M' || blob[1] != '3' || blob[2] != 'C' ||
+        blob[3] != MAX3000_CALIBRATION_VERSION) {
+        return false;
+    }
+    size_t boards       = blob[4] | ((size_t)blob[5] << 8);
+    uint8_t blobClasses = blob[6];
+    size_t length       = BLOB_HEADER_SIZE + blobClasses * 2 + boards * 4 + BLOB_HASH_SIZE;
+    if(blobClasses == 0 || blobClasses > MAX3000_CALIBRATION_CLASSES || size < length) {
+        return false;
+    }
+
+    const uint8_t * hashBytes = &blob[length - BLOB_HASH_SIZE];
+    uint32_t hash             = 0;
+    for(uint8_t i = 0; i < BLOB_HASH_SIZE; ++i) {
+        hash |= (uint32_t)hashBytes[i] << (i * 8);
+    }
+    if(hash != MAX3000_Plan::hash(blob, length - BLOB_HASH_SIZE)) {
+        return false;
+    }
+
+    // Every bank has to refer to one of the blob's classes
+    const uint8_t * blobMap = &blob[BLOB_HEADER_SIZE + blobClasses * 2];
+    for(size_t i = 0; i < boards * 4; ++i) {
+        if((blobMap[i] & 0xF) >= blobClasses || (blobMap[i] >> 4) >= blobClasses) {
+            return false;
+        }
+    }
+
+    if(!begin(boards)) {
+        return false;
+    }
+    numClasses = blobClasses;
+    for(uint8_t durationClass = 0; durationClass < numClasses; ++durationClass) {
+        durations[durationClass] = blob[BLOB_HEADER_SIZE + durationClass * 2] | (blob[BLOB_HEADER_SIZE + durationClass * 2 + 1] << 8);
+    }
+    memcpy(classes, blobMap, numBoards * 4);
+    nextGeneration();
+    return true;
+}
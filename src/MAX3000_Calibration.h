@@ -0,0 +1,192 @@
+/**
+ * @file MAX3000_Calibration.h
+ *
+ * Pulse durations calibrated per board and per decoder bank.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * The pulse duration set with MAX3000_Base::setPulseDurationUs() has to flip
+ * the stickiest dot of the whole wall, so every pulse is held that long. A
+ * \ref MAX3000_Calibration gives each board its own duration, and optionally
+ * each of its decoder banks: four banks of columns, selected by the upper two
+ * bits of the column code, by two banks of rows, selected by the upper bit of
+ * the row code.
+ *
+ * The distinct durations of the map form its duration classes, at most
+ * MAX3000_CALIBRATION_CLASSES. Each board flips its pixels one class at a
+ * time, slowest first, and each pulse lasts as long as the slowest pixel it
+ * drives. The slow pixels of every board share the first, long pulses, and
+ * the rest of the update runs at the speed of the fast dots, with about as
+ * many pulses as without a calibration.
+ *
+ * The map is stored in 4 bytes per board, and saved to and loaded from a
+ * compact binary blob, little-endian on every platform, so a map measured
+ * on a Raspberry Pi can be kept in a microcontroller's EEPROM or flash:
+ *
+ *     Offset        Size           Contents
+ *     0             4              "M3C" and the format version, 1
+ *     4             2              Number of boards
+ *     6             1              Number of classes
+ *     7             2 per class    Duration of each class in microseconds
+ *     ...           4 per board    Class of each bank, two banks per byte, low nibble first
+ *     ...           4              FNV-1a hash of all preceding bytes
+ */
+
+#ifndef _MAX3000_Calibration_H_
+#define _MAX3000_Calibration_H_
+
+#include <MAX3000_Transport.h>
+
+#define MAX3000_CALIBRATION_CLASSES 16    // Maximum number of distinct pulse durations
+#define MAX3000_CALIBRATION_BANKS 8       // Decoder banks of each board, 4 of columns by 2 of rows
+#define MAX3000_CALIBRATION_VERSION 1     // Format version of the binary blob
+
+// Bank of a column and a row bank, as passed to MAX3000_Calibration::getClass()
+#define MAX3000_CALIBRATION_BANK(_colBank, _rowBank) ((_colBank) | ((_rowBank) << 2))
+
+/**
+ * @brief Map of pulse durations per board and decoder bank
+ */
+class MAX3000_Calibration {
+  public:
+    /**
+     * @brief Constructs an empty map. Call begin() or load() before use.
+     */
+    MAX3000_Calibration(void);
+
+    /**
+     * @brief Destructor, frees the map.
+     */
+    ~MAX3000_Calibration(void);
+
+    /**
+     * @brief Allocates the map, with the same duration for every board.
+     *
+     * @param numBoards Number of boards in the chain.
+     * @param durationUs Duration of every pulse until calibrated, in microseconds.
+     * @return Returns true on success, or false if allocation fails.
+     */
+    bool begin(size_t numBoards, uint16_t durationUs = 250);
+
+    /**
+     * @brief Sets the duration of every bank of a board.
+     *
+     * @param board Board Index, starting from 0
+     * @param durationUs Duration in microseconds.
+     * @return Returns false if the board is out of range, or the map already
+     *         holds MAX3000_CALIBRATION_CLASSES other durations.
+     */
+    bool setBoardDurationUs(size_t board, uint16_t durationUs);
+
+    /**
+     * @brief Sets the duration of one decoder bank of a board.
+     *
+     * @param board Board Index, starting from 0
+     * @param colBank Column bank, 0 to 3, the upper two bits of the column code.
+     * @param rowBank Row bank, 0 or 1, the upper bit of the row code.
+     * @param durationUs Duration in microseconds.
+     * @return Returns false if the bank is out of range, or the map already
+     *         holds MAX3000_CALIBRATION_CLASSES other durations.
+     */
+    bool setBankDurationUs(size_t board, uint8_t colBank, uint8_t rowBank, uint16_t durationUs);
+
+    /**
+     * @brief Returns the duration of one decoder bank of a board in microseconds, or 0 if out of range.
+     */
+    uint16_t getBankDurationUs(size_t board, uint8_t colBank, uint8_t rowBank) const;
+
+    /**
+     * @brief Returns the number of boards in the map.
+     */
+    size_t getBoardCount(void) const { return numBoards; }
+
+    /**
+     * @brief Returns the number of duration classes, including any no longer used by a bank.
+     */
+    uint8_t getClassCount(void) const { return numClasses; }
+
+    /**
+     * @brief Returns the duration of a class in microseconds.
+     */
+    uint16_t getClassDurationUs(uint8_t durationClass) const { return durations[durationClass]; }
+
+    /**
+     * @brief Returns the duration class of a bank of a board.
+     *
+     * @param board Board Index, starting from 0
+     * @param bank Bank, see MAX3000_CALIBRATION_BANK().
+     */
+    uint8_t getClass(size_t board, uint8_t bank) const { return (classes[board * 4 + (bank >> 1)] >> ((bank & 1) * 4)) & 0xF; }
+
+    /**
+     * @brief Returns a number identifying the contents of the map.
+     *
+     * Every change to the map gives it a new generation, never used by any
+     * other map, so plans grouped by the classes of one version of a map
+     * aren't replayed with another. 0 is never a generation.
+     */
+    uint32_t getGeneration(void) const { return generation; }
+
+    /**
+     * @brief Returns the size of the blob written by save(), in bytes.
+     */
+    size_t getBlobSize(void) const;
+
+    /**
+     * @brief Writes the map to a binary blob.
+     *
+     * @param blob Buffer to write to.
+     * @param size Size of the buffer in bytes.
+     * @return Number of bytes written, or 0 if the buffer is too small.
+     */
+    size_t save(uint8_t * blob, size_t size) const;
+
+    /**
+     * @brief Reads the map from a binary blob written by save().
+     *
+     * The map is left unchanged if the blob is truncated, corrupted or of
+     * another format version.
+     *
+     * @param blob Blob to read, in RAM.
+     * @param size Size of the blob in bytes.
+     * @return Returns true on success.
+     */
+    bool load(const uint8_t * blob, size_t size);
+
+  protected:
+    /**
+     * @brief Returns the class of a duration, adding it if needed.
+     *
+     * Reuses the slot of a class no bank refers to anymore before adding one.
+     *
+     * @return The class, or MAX3000_CALIBRATION_CLASSES if the map is full.
+     */
+    uint8_t findClass(uint16_t durationUs);
+
+    /**
+     * @brief Sets the class of a bank of a board.
+     */
+    void setClass(size_t board, uint8_t bank, uint8_t durationClass);
+
+    /**
+     * @brief Gives the map a new generation, after changing it.
+     */
+    void nextGeneration(void);
+
+    /** @brief Class of each bank of each board, two banks per byte, low nibble first */
+    uint8_t * classes;
+
+    /** @brief Number of boards in the map */
+    size_t numBoards;
+
+    /** @brief Duration of each class in microseconds */
+    uint16_t durations[MAX3000_CALIBRATION_CLASSES];
+
+    /** @brief Number of classes in \ref durations */
+    uint8_t numClasses;
+
+    /** @brief Generation of the contents, see getGeneration() */
+    uint32_t generation;
+};
+
+#endif    // _MAX3000_Calibration_H_
@@ -0,0 +1,155 @@
+/**
+ * @file MAX3000_Engine.cpp
+ *
+ * Background display engine for Linux hosts, such as the Raspberry Pi.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#ifdef WIRINGPI
+#include <MAX3000_Engine.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#define SLOT_INDEX 0x03    // Index of the frame in the slot
+#define SLOT_FRESH 0x04    // Set while the frame in the slot wasn't taken by the engine
+
+bool MAX3000_EngineOptions::apply(std::thread & thread) const {
+    bool ok = true;
+    if(cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        ok = ok && pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) == 0;
+    }
+    if(priority > 0) {
+        struct sched_param param;
+        param.sched_priority = priority;
+        ok = ok && pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param) == 0;
+    }
+    return ok;
+}
+
+MAX3000_Engine::MAX3000_Engine(MAX3000_Base & display_)
+    : display(display_),
+      appFrame(0),
+      engineFrame(1),
+      slot(2),
+      running(false),
+      stopping(false),
+      frameNumber(0) {
+    frameSize = display.config.width * ((display.config.height + 7) / 8);
+    for(size_t i = 0; i < 3; ++i) {
+        frames[i].pixels = new uint8_t[frameSize];
+        frames[i].number = 0;
+    }
+    sem_init(&wake, 0, 0);
+}
+
+MAX3000_Engine::~MAX3000_Engine(void) {
+    stop();
+    sem_destroy(&wake);
+    for(size_t i = 0; i < 3; ++i) {
+        delete[] frames[i].pixels;
+    }
+}
+
+bool MAX3000_Engine::start(const MAX3000_EngineOptions & options) {
+    if(running) {
+        return true;
+    }
+
+    if(options.lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        return false;
+    }
+
+    stopping = false;
+    running  = true;
+    try {
+        thread = std::thread(&MAX3000_Engine::run, this);
+    } catch(const std::system_error &) {
+        running = false;
+        return false;
+    }
+
+    // Scheduling is applied from here, so failures can be reported.
+    if(!options.apply(thread)) {
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+void MAX3000_Engine::stop(void) {
+    if(thread.joinable()) {
+        stopping = true;
+        sem_post(&wake);
+        thread.join();
+    }
+    running = false;
+
+    // Report a frame the engine never took
+    uint8_t previous = slot.load();
+    if(previous & SLOT_FRESH) {
+        slot = previous & SLOT_INDEX;
+        finish(frames[previous & SLOT_INDEX], false);
+    }
+}
+
+std::future<bool> MAX3000_Engine::submit(void) {
+    Frame & frame = frames[appFrame];
+    memcpy(frame.pixels, display.buffer, frameSize);
+    frame.number = ++frameNumber;
+    frame.done   = std::promise<bool>();
+    std::future<bool> result = frame.done.get_future();
+
+    // Publish the frame, and take back whichever frame was in the slot.
+    // If the engine didn't take that one yet, it will never be shown.
+    uint8_t previous = slot.exchange(appFrame | SLOT_FRESH, std::memory_order_acq_rel);
+    appFrame         = previous & SLOT_INDEX;
+    if(previous & SLOT_FRESH) {
+        finish(frames[appFrame], false);
+    }
+
+    sem_post(&wake);
+    return result;
+}
+
+void MAX3000_Engine::run(void) {
+    while(!stopping) {
+        if(sem_wait(&wake) != 0) {
+            continue;    // EINTR
+        }
+
+        // Only the engine clears SLOT_FRESH, so the slot can't go stale between these.
+        if(!(slot.load(std::memory_order_acquire) & SLOT_FRESH)) {
+            continue;
+        }
+        uint8_t previous = slot.exchange(engineFrame, std::memory_order_acq_rel);
+        engineFrame      = previous & SLOT_INDEX;
+
+        // Send one pulse at a time, so a newer frame can replace the target
+        // of the update as soon as it arrives.
+        display.beginUpdate(frames[engineFrame].pixels, false, false);
+        while(display.displayStep(0)) {
+            if(slot.load(std::memory_order_acquire) & SLOT_FRESH) {
+                finish(frames[engineFrame], false);
+                previous    = slot.exchange(engineFrame, std::memory_order_acq_rel);
+                engineFrame = previous & SLOT_INDEX;
+                display.beginUpdate(frames[engineFrame].pixels, false, false);
+            }
+        }
+        finish(frames[engineFrame], true);
+    }
+}
+
+void MAX3000_Engine::finish(Frame & frame, bool shown) {
+    frame.done.set_value(shown);
+    if(callback) {
+        callback(frame.number, shown);
+    }
+}
+#endif
@@ -0,0 +1,178 @@
+/**
+ * @file MAX3000_Engine.h
+ *
+ * Background display engine for Linux hosts, such as the Raspberry Pi.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * MAX3000_Engine runs the display() flip loop of a display on a dedicated
+ * thread, optionally with real-time scheduling, pinned to a CPU and with its
+ * memory locked, so pulse timing isn't disturbed by the application.
+ *
+ * The application keeps drawing into the display as usual, and hands each
+ * finished frame to the engine with submit(). Frames pass through a
+ * lock-free latest-frame slot: if the application submits faster than the
+ * panels can flip, frames still waiting in the slot are replaced, and only
+ * the most recent one is shown. A frame arriving during an update replaces
+ * its target, so pixels that would be overwritten aren't flipped. Completion
+ * is reported through the returned future, and optionally a callback.
+ *
+ * Only built with -DWIRINGPI.
+ */
+
+#ifndef _MAX3000_Engine_H_
+#define _MAX3000_Engine_H_
+
+#include <MAX3000_Lib.h>
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <thread>
+#include <semaphore.h>
+
+/**
+ * @brief Scheduling options of the engine thread
+ */
+struct MAX3000_EngineOptions {
+    /**
+     * @brief Constructs options for a normal, unpinned thread.
+     */
+    MAX3000_EngineOptions(void)
+        : priority(0),
+          cpu(-1),
+          lockMemory(false) {
+    }
+
+    /**
+     * @brief Pins a running thread to the CPU, and sets its priority.
+     *
+     * Memory locking applies to the whole process, and is left to the caller.
+     *
+     * @param thread Thread to schedule.
+     * @return Returns true if all requested options were applied.
+     */
+    bool apply(std::thread & thread) const;
+
+    int priority;       // SCHED_FIFO priority from 1 to 99, or 0 to keep the default scheduler
+    int cpu;            // CPU to pin the thread to, or -1 to run on any CPU
+    bool lockMemory;    // Lock all current and future pages of the process into RAM (mlockall)
+};
+
+/**
+ * @brief Runs display updates of a MAX3000 display on a background thread
+ */
+class MAX3000_Engine {
+  public:
+    /**
+     * @brief Called when a submitted frame is done.
+     *
+     * The first parameter is the frame number returned by \ref getLastFrameNumber
+     * after the submit, the second is true if the frame was shown, or false if
+     * it was replaced by a newer frame before it could be. Frames replaced in
+     * the slot are reported from \ref submit, others on the engine thread.
+     */
+    typedef std::function<void(uint32_t, bool)> Callback;
+
+    /**
+     * @brief Constructs a new engine for a display.
+     *
+     * The display must have been started with begin(), and must outlive the engine.
+     *
+     * @param display Display to update.
+     */
+    MAX3000_Engine(MAX3000_Base & display);
+
+    /**
+     * @brief Destructor, stops the engine thread.
+     */
+    ~MAX3000_Engine(void);
+
+    /**
+     * @brief Starts the engine thread.
+     *
+     * While the engine is running, the display's own display() and
+     * invertDisplay() must not be called, and its settings should not change.
+     *
+     * @param options Scheduling options of the thread.
+     * @return Returns true if the thread started with all requested options.
+     */
+    bool start(const MAX3000_EngineOptions & options = MAX3000_EngineOptions());
+
+    /**
+     * @brief Stops the engine thread, after the frame being shown is done.
+     *
+     * A frame still waiting in the slot is reported as not shown.
+     */
+    void stop(void);
+
+    /**
+     * @brief Hands the display's current frame buffer to the engine.
+     *
+     * The frame is copied, so drawing can continue right away.
+     *
+     * @return Future resolving to true once the frame is shown, or false if
+     *         it was replaced by a newer frame or the engine stopped first.
+     */
+    std::future<bool> submit(void);
+
+    /**
+     * @brief Sets the callback run as submitted frames are done.
+     *
+     * Set before \ref start.
+     *
+     * @param callback Function to call, or an empty function for none.
+     */
+    void setCallback(const Callback & callback) { this->callback = callback; }
+
+    /**
+     * @brief Returns the number of the most recently submitted frame.
+     */
+    uint32_t getLastFrameNumber(void) const { return frameNumber; }
+
+    /**
+     * @brief Returns true while the engine thread is running.
+     */
+    bool isRunning(void) const { return running; }
+
+  protected:
+    /**
+     * @brief A frame buffer and its completion state
+     */
+    struct Frame {
+        uint8_t * pixels;
+        uint32_t number;
+        std::promise<bool> done;
+    };
+
+    /**
+     * @brief Main loop of the engine thread.
+     */
+    void run(void);
+
+    /**
+     * @brief Completes the promise of a frame, and runs the callback.
+     */
+    void finish(Frame & frame, bool shown);
+
+    MAX3000_Base & display;
+    size_t frameSize;
+
+    // Frames are passed with a triple buffer. The application owns one frame
+    // to fill, the engine owns the one it shows, and the third sits in the
+    // slot. Ownership moves by exchanging indexes with the slot, which holds
+    // the index of its frame, plus SLOT_FRESH if it wasn't taken yet.
+    Frame frames[3];
+    uint8_t appFrame;
+    uint8_t engineFrame;
+    std::atomic<uint8_t> slot;
+
+    sem_t wake;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> stopping;
+    uint32_t frameNumber;
+    Callback callback;
+};
+
+#endif    // _MAX3000_Engine_H_
@@ -91,24 +91,35 @@ void MAX3000_GFX::drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_
             w = (WIDTH - x);
         }
         if(w > 0) {    // Proceed only if width is positive
-            uint8_t *pBuf = &buffer[(y / 8) * WIDTH + x], mask = 1 << (y & 7);
-            switch(color) {
-                case MAX3000_LIGHT:
-                    while(w--) {
-                        *pBuf++ |= mask;
-                    };
-                    break;
-                case MAX3000_DARK:
-                    mask = ~mask;
-                    while(w--) {
-                        *pBuf++ &= mask;
-                    };
-                    break;
-                case MAX3000_INVERSE:
-                    while(w--) {
-                        *pBuf++ ^= mask;
-                    };
-                    break;
+            markDirty(x, y, w, 1);
+            while(w > 0) {
+                // Columns are only consecutive within a panel in MAX3000_LAYOUT_PANEL
+                int16_t run = w;
+                if(config.bufferLayout == MAX3000_LAYOUT_PANEL && run > PANEL_WIDTH - (x % PANEL_WIDTH)) {
+                    run = PANEL_WIDTH - (x % PANEL_WIDTH);
+                }
+
+                uint8_t *pBuf = &buffer[pixelOffset(x, y)], mask = 1 << (y & 7);
+                x += run;
+                w -= run;
+                switch(color) {
+                    case MAX3000_LIGHT:
+                        while(run--) {
+                            *pBuf++ |= mask;
+                        };
+                        break;
+                    case MAX3000_DARK:
+                        mask = ~mask;
+                        while(run--) {
+                            *pBuf++ &= mask;
+                        };
+                        break;
+                    case MAX3000_INVERSE:
+                        while(run--) {
+                            *pBuf++ ^= mask;
+                        };
+                        break;
+                }
             }
         }
     }
@@ -155,10 +166,12 @@ void MAX3000_GFX::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uin
             __h = (HEIGHT - __y);
         }
         if(__h > 0) {    // Proceed only if height is now positive
-            // this display doesn't need ints for coordinates,
-            // use local byte registers for faster juggling
-            uint8_t y = __y, h = __h;
-            uint8_t * pBuf = &buffer[(y / 8) * WIDTH + x];
+            markDirty(x, __y, 1, __h);
+
+            // walls can be taller than 255 rows, so coordinates need
+            // 16 bits, but never a sign
+            uint16_t y = __y, h = __h;
+            uint8_t * pBuf = &buffer[pixelOffset(x, y)];
 
             // do the first partial byte, if necessary - this requires some masking
             uint8_t mod = (y & 7);
@@ -185,7 +198,10 @@ void MAX3000_GFX::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uin
                         *pBuf ^= mask;
                         break;
                 }
-                pBuf += WIDTH;
+                y += mod;
+                if(h > mod) {    // Only address rows that exist
+                    pBuf = &buffer[pixelOffset(x, y)];
+                }
             }
 
             if(h >= mod) {    // More to go?
@@ -197,16 +213,22 @@ void MAX3000_GFX::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uin
                         // black/white write version with an extra comparison per loop
                         do {
                             *pBuf ^= 0xFF;    // Invert byte
-                            pBuf += WIDTH;    // Advance pointer 8 rows
+                            y += 8;           // Advance 8 rows
                             h -= 8;           // Subtract 8 rows from height
+                            if(h) {
+                                pBuf = &buffer[pixelOffset(x, y)];    // Pages aren't evenly spaced in all layouts
+                            }
                         } while(h >= 8);
                     } else {
                         // store a local value to work with
                         uint8_t val = (color != MAX3000_DARK) ? 255 : 0;
                         do {
-                            *pBuf = val;      // Set byte
-                            pBuf += WIDTH;    // Advance pointer 8 rows
-                            h -= 8;           // Subtract 8 rows from height
+                            *pBuf = val;    // Set byte
+                            y += 8;         // Advance 8 rows
+                            h -= 8;         // Subtract 8 rows from height
+                            if(h) {
+                                pBuf = &buffer[pixelOffset(x, y)];    // Pages aren't evenly spaced in all layouts
+                            }
                         } while(h >= 8);
                     }
                 }
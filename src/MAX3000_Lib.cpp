@@ -23,97 +23,84 @@
  */
 
 #include <MAX3000_Lib.h>
-
-#ifdef __AVR__
-#include <avr/pgmspace.h>
-#elif defined(ESP8266) || defined(ESP32) || defined(ARDUINO_ARCH_RP2040)
-#include <pgmspace.h>
-#else
-#define pgm_read_byte(addr) (*(const unsigned char *)(addr))    ///< PROGMEM workaround for non-AVR
-#endif
-
-#if !defined(__ARM_ARCH) && !defined(ENERGIA) && !defined(ESP8266) && !defined(ESP32) && !defined(__arc__)
-#include <util/delay.h>
-#endif
-
-// Extra delay when bitbanging on ESP32, which updates much faster than AVR
-#if defined(ESP32) || defined(ESP8266) || defined(ARDUINO_ARCH_STM32)
-#define BITBANG_DELAY delayMicroseconds(5);
-#elif defined(WIRINGPI)
-#define BITBANG_DELAY delayMicroseconds(8);
-#else
-#define BITBANG_DELAY
-#endif
+#include <MAX3000_Update.h>
 
 #define MAX3000_swap(a, b) (((a) ^= (b)), ((b) ^= (a)), ((a) ^= (b)))
-#define LOAD_SR(_b, _p, _e)     \
-    shiftReg[_b] &= ~(1 << _p); \
-    shiftReg[_b] |= ((_e ? HIGH : LOW) << _p);
-#define BUFFER_SIZE config.width *((config.height + 7) / 8)
-
-#ifdef HAVE_PORTREG
-#define MAX3000_LATCH *latPort |= latPinMask;           ///< Shift Register Latch
-#define MAX3000_UNLATCH *latPort &= ~latPinMask;        ///< Shift Register Unlatch
-#define MAX3000_PULSE *pulsePort |= pulsePinMask;       ///< PULSE_ENABLE active
-#define MAX3000_UNPULSE *pulsePort &= ~pulsePinMask;    ///< PULSE_ENABLE inactive
-#define MAX3000_PULSE_ROW *rowPort &= ~rowPinMask;      ///< ROW_ENABLE_N active
-#define MAX3000_UNPULSE_ROW *rowPort |= rowPinMask;     ///< ROW_ENABLE_N inactive
-#define MAX3000_PULSE_COL *colPort &= ~colPinMask;      ///< COL_ENABLE_N active
-#define MAX3000_UNPULSE_COL *colPort |= colPinMask;     ///< COL_ENABLE_N inactive
-#else
-#define MAX3000_LATCH digitalWrite(config.lat_pin, HIGH);          ///< Shift Register Latch
-#define MAX3000_UNLATCH digitalWrite(config.lat_pin, LOW);         ///< Shift Register Unlatch
-#define MAX3000_PULSE digitalWrite(config.pulse_pin, HIGH);        ///< PULSE_ENABLE active
-#define MAX3000_UNPULSE digitalWrite(config.pulse_pin, LOW);       ///< PULSE_ENABLE inactive
-#define MAX3000_PULSE_ROW digitalWrite(config.row_pin, LOW);       ///< ROW_ENABLE_N active
-#define MAX3000_UNPULSE_ROW digitalWrite(config.row_pin, HIGH);    ///< ROW_ENABLE_N inactive
-#define MAX3000_PULSE_COL digitalWrite(config.col_pin, LOW);       ///< COL_ENABLE_N active
-#define MAX3000_UNPULSE_COL digitalWrite(config.col_pin, HIGH);    ///< COL_ENABLE_N inactive
-#endif
+#define BUFFER_SIZE ((size_t)config.width * ((config.height + 7) / 8))
 
-// SPI transactions  not present in older Arduino SPI lib
-#if defined(SPI_HAS_TRANSACTION)
-#define SPI_TRANSACTION_START \
-    if(config.spi) config.spi->beginTransaction(spiSettings);    ///< Pre-SPI
-#define SPI_TRANSACTION_END \
-    if(config.spi) config.spi->endTransaction();    ///< Post-SPI
-#else
-#define SPI_TRANSACTION_START    ///< Dummy stand-in define
-#define SPI_TRANSACTION_END      ///< keeps compiler happy
-#endif
+// Period of constant frame rate updates, the longest update of a single panel
+#define CONSTANT_FRAME_PERIOD ((uint32_t)PANEL_HEIGHT * PANEL_WIDTH * (pulseDuration + 10 + 290))
 
-// Shift Register bit definitions on each driver
-#define SR_PIN_COL_A2 0
-#define SR_PIN_COL_A1 1
-#define SR_PIN_COL_A0 2
-#define SR_PIN_ROW_A0 3
-#define SR_PIN_ROW_A1 4
-#define SR_PIN_ROW_A2 5
-#define SR_PIN_ROW_BANK 6
-#define SR_PIN_COL_BANK0 7
-#define SR_PIN_COL_SOURCE 8
-#define SR_PIN_ROW_SOURCE 10
-#define SR_PIN_COL_BANK1 11
-#define SR_PIN_USER_LED 13
+#define ADDRESS_MASK (MAX3000_COL_WORD(0x1F) | MAX3000_ROW_WORD(0xF))
+
+// The standard panel's rows are reversed, so its codes are listed from the bottom row up.
+const MAX3000_Panel MAX3000_PANEL_28X16 PROGMEM =
+    MAX3000_makePanel(MAX3000_PANEL_28X16_COLS, MAX3000_PANEL_28X16_ROWS, MAX3000_ORIENT_MIRROR_Y);
 
 MAX3000_Base::MAX3000_Base(const MAX3000_Config & config_)
-    : config(config_), buffer(NULL) {
-    localWidth          = config.width;
-    localHeight         = config.height;
-    invertEnabled   = false;
-    dissolveEnabled = false;
-    constantRate    = false;
-    firstUpdate     = true;
+    : config(config_),
+      buffer(NULL),
+      frontBuffer(NULL),
+      targetBuffer(NULL),
+      oldBuffer(NULL),
+      cursorClass(NULL),
+      classPassed(NULL),
+      scanNext(NULL),
+      shiftReg(NULL),
+      setCursor(NULL),
+      clearCursor(NULL),
+      pending(NULL),
+      pendingSet(NULL),
+      pendingClear(NULL),
+      boardOffsets(NULL),
+      boardPanels(NULL),
+      panelBoards(NULL),
+      boardOrientation(NULL),
+      boardTypes(NULL),
+      dirtyFirst(NULL),
+      dirtyLast(NULL) {
+    localWidth        = config.width;
+    localHeight       = config.height;
+    localRotation     = 0;
+    invertEnabled     = false;
+    dissolveEnabled   = false;
+    dissolveKey       = 0;
+    scanOrder         = NULL;
+    scanType          = MAX3000_SCAN_SEQUENTIAL;
+    scanStep          = 0;
+    framePeriod       = 0;
+    constantFrameRate = false;
+    frameDeadline     = 0;
+    frameScheduled    = false;
+    firstUpdate       = true;
+    bufferUntracked   = false;
+    pulseMode         = MAX3000_PULSE_SEPARATE;
+    pulseDirection    = 0;
+    shiftDirection    = 0;
+    shiftBit          = 0;
+    pulseStart        = 0;
+    updateActive      = false;
+    planning          = false;
+    activePlan        = NULL;
+    planPulse         = 0;
+    planCache         = NULL;
+    pageStride        = (config.bufferLayout == MAX3000_LAYOUT_PANEL) ? PANEL_WIDTH : config.width;
 
     // 250uS has been determined to be a decent compromise between frame rate and flip reliability
     pulseDuration = 250;
+    pulseWindow   = pulseDuration;
+    shiftWindow   = pulseDuration;
+    calibration   = NULL;
+    pulseClass    = CLASS_NONE;
 
-#ifdef SPI_HAS_TRANSACTION
-    spiSettings = SPISettings(config.spi_bitrate, MSBFIRST, SPI_MODE0);
-#endif
+    transport = config.transport ? config.transport : &pinTransport;
 }
 
 MAX3000_Base::~MAX3000_Base(void) {
+    if(frontBuffer && frontBuffer != buffer) {
+        free(frontBuffer);
+    }
+    frontBuffer = NULL;
     if(buffer) {
         free(buffer);
         buffer = NULL;
@@ -122,51 +109,78 @@ MAX3000_Base::~MAX3000_Base(void) {
         free(oldBuffer);
         oldBuffer = NULL;
     }
-    if(shuffledIndex) {
-        delete[] shuffledIndex;
-        shuffledIndex = NULL;
-    }
     if(shiftReg) {
         delete[] shiftReg;
         shiftReg = NULL;
     }
+    if(setCursor) {
+        delete[] setCursor;
+        setCursor = NULL;
+    }
+    if(clearCursor) {
+        delete[] clearCursor;
+        clearCursor = NULL;
+    }
+    if(pending) {
+        delete[] pending;
+        pending = NULL;
+    }
+    if(pendingSet) {
+        delete[] pendingSet;
+        pendingSet = NULL;
+    }
+    if(pendingClear) {
+        delete[] pendingClear;
+        pendingClear = NULL;
+    }
+    if(dirtyFirst) {
+        delete[] dirtyFirst;
+        dirtyFirst = NULL;
+    }
+    if(dirtyLast) {
+        delete[] dirtyLast;
+        dirtyLast = NULL;
+    }
+    if(scanNext) {
+        delete[] scanNext;
+        scanNext = NULL;
+    }
+    if(boardOffsets) {
+        delete[] boardOffsets;
+        boardOffsets = NULL;
+    }
+    if(boardPanels) {
+        delete[] boardPanels;
+        boardPanels = NULL;
+    }
+    if(panelBoards) {
+        delete[] panelBoards;
+        panelBoards = NULL;
+    }
+    if(boardOrientation) {
+        delete[] boardOrientation;
+        boardOrientation = NULL;
+    }
+    if(boardTypes) {
+        delete[] boardTypes;
+        boardTypes = NULL;
+    }
+    if(cursorClass) {
+        delete[] cursorClass;
+        cursorClass = NULL;
+    }
+    if(classPassed) {
+        delete[] classPassed;
+        classPassed = NULL;
+    }
 }
 
 inline void
 MAX3000_Base::shiftRegWrite() {
-    // Push each board through the chain, starting with the last board
-    SPI_TRANSACTION_START
-    for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
-        if(config.spi) {
-            (void)config.spi->transfer16(shiftReg[board]);
-        } else {
-            for(uint16_t bit = 0x8000; bit; bit >>= 1) {
-#ifdef HAVE_PORTREG
-                if(shiftReg[board] & bit)
-                    *mosiPort |= mosiPinMask;
-                else
-                    *mosiPort &= ~mosiPinMask;
-                BITBANG_DELAY
-                *clkPort |= clkPinMask;
-                BITBANG_DELAY
-                *clkPort &= ~clkPinMask;
-                BITBANG_DELAY
-#else
-                digitalWrite(config.mosi_pin, (bool)(shiftReg[board] & bit));
-                BITBANG_DELAY
-                digitalWrite(config.sclk_pin, HIGH);
-                BITBANG_DELAY
-                digitalWrite(config.sclk_pin, LOW);
-                BITBANG_DELAY
-#endif
-            }
-        }
-    }
-    SPI_TRANSACTION_END
+    transport->shift(shiftReg, config.numHBoards * config.numVBoards);
 
     // Once shift register buffer has been shifted in, latch the output pins.
-    MAX3000_LATCH
-    MAX3000_UNLATCH
+    transport->latch();
 }
 
 bool MAX3000_Base::begin(bool reset, bool periphBegin) {
@@ -180,76 +194,128 @@ bool MAX3000_Base::begin(bool reset, bool periphBegin) {
     memset(buffer, 0, BUFFER_SIZE);
     memset(oldBuffer, 0, BUFFER_SIZE);
 
-    // Create initial index buffer, which will get shuffled on the first load.
-    // Each panel received the same shuffled index for space concerns.
-    if((!shuffledIndex) && !(shuffledIndex = new int[PANEL_HEIGHT * PANEL_WIDTH])) {
+    // Create the front buffer, when drawing is separate from the displayed frame
+    if(config.bufferMode == MAX3000_BUFFER_DOUBLE) {
+        if((!frontBuffer) && !(frontBuffer = (uint8_t *)malloc(BUFFER_SIZE))) {
+            return false;
+        }
+        memset(frontBuffer, 0, BUFFER_SIZE);
+    } else {
+        frontBuffer = buffer;
+    }
+
+    // Create the tables mapping boards to their panels, so positions are
+    // never computed from the board order while drawing or flipping.
+    if((!boardOffsets) && !(boardOffsets = new size_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    if((!boardPanels) && !(boardPanels = new uint16_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    if((!panelBoards) && !(panelBoards = new uint16_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    if((!boardOrientation) && !(boardOrientation = new uint8_t[config.numVBoards * config.numHBoards])) {
         return false;
     }
-    for(int i = 0; i < PANEL_HEIGHT * PANEL_WIDTH; i++) {
-        shuffledIndex[i] = i;
+    if((!boardTypes) && !(boardTypes = new const MAX3000_Panel *[config.numVBoards * config.numHBoards])) {
+        return false;
     }
+    mapBoards();
 
     // Create buffer for output to each shift register
     if((!shiftReg) && !(shiftReg = new uint16_t[config.numVBoards * config.numHBoards])) {
         return false;
     }
     memset(shiftReg, 0, config.numVBoards * config.numHBoards * sizeof(uint16_t));
+    checkCalibration();
 
-    // Set up hardware pin modes
-    pinMode(config.lat_pin, OUTPUT);
-    pinMode(config.rst_pin, OUTPUT);
-    pinMode(config.pulse_pin, OUTPUT);
-    pinMode(config.col_pin, OUTPUT);
-    pinMode(config.row_pin, OUTPUT);
-
-#ifdef HAVE_PORTREG
-    latPort      = (PortReg *)portOutputRegister(digitalPinToPort(config.lat_pin));
-    latPinMask   = digitalPinToBitMask(config.lat_pin);
-    pulsePort    = (PortReg *)portOutputRegister(digitalPinToPort(config.pulse_pin));
-    pulsePinMask = digitalPinToBitMask(config.pulse_pin);
-    rowPort      = (PortReg *)portOutputRegister(digitalPinToPort(config.row_pin));
-    rowPinMask   = digitalPinToBitMask(config.row_pin);
-    colPort      = (PortReg *)portOutputRegister(digitalPinToPort(config.col_pin));
-    colPinMask   = digitalPinToBitMask(config.col_pin);
-#endif
+    // Create the per-board positions used to schedule pulses in display()
+    if((!setCursor) && !(setCursor = new uint16_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    if((!clearCursor) && !(clearCursor = new uint16_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
 
-    // Initialize SPI (either hardware or software)
-    if(config.spi) {
-        if(periphBegin) {
-            config.spi->begin();
-        }
-    } else {
-        pinMode(config.mosi_pin, OUTPUT);
-        pinMode(config.sclk_pin, OUTPUT);
-#ifdef HAVE_PORTREG
-        mosiPort    = (PortReg *)portOutputRegister(digitalPinToPort(config.mosi_pin));
-        mosiPinMask = digitalPinToBitMask(config.mosi_pin);
-        clkPort     = (PortReg *)portOutputRegister(digitalPinToPort(config.sclk_pin));
-        clkPinMask  = digitalPinToBitMask(config.sclk_pin);
-        *clkPort &= ~clkPinMask;
-#else
-        digitalWrite(config.sclk_pin, LOW);
-#endif
+    // Create the per-board change masks filled in by display()
+    if((!pending) && !(pending = new uint8_t[config.numVBoards * config.numHBoards * PANEL_PENDING_BYTES])) {
+        return false;
+    }
+    if((!pendingSet) && !(pendingSet = new uint16_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    if((!pendingClear) && !(pendingClear = new uint16_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    if((!scanNext) && !(scanNext = new uint16_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+
+    // Create the per-board column ranges written by drawing operations
+    if((!dirtyFirst) && !(dirtyFirst = new uint8_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    if((!dirtyLast) && !(dirtyLast = new uint8_t[config.numVBoards * config.numHBoards])) {
+        return false;
+    }
+    markAllDirty();
+
+    // Set up hardware pins and SPI
+    if(!transport->begin(config, periphBegin)) {
+        return false;
     }
 
     // Set initial non-pulse state
-    MAX3000_UNPULSE
-    MAX3000_UNPULSE_ROW
-    MAX3000_UNPULSE_COL
+    transport->setPulseEnable(false);
+    transport->setRowEnable(false);
+    transport->setColEnable(false);
 
-    // Reset MAX3000 if requested and reset pin specified in constructor
-    if(reset && (config.rst_pin >= 0)) {
-        digitalWrite(config.rst_pin, HIGH);
-        delay(1);
-        digitalWrite(config.rst_pin, LOW);
-        delay(10);
-        digitalWrite(config.rst_pin, HIGH);
-        delay(5);
+    // Reset MAX3000 if requested
+    if(reset) {
+        transport->reset();
     }
 
     return true;
 }
 
+void MAX3000_Base::mapBoards(void) {
+    size_t numH = config.numHBoards;
+    size_t numV = config.numVBoards;
+
+    for(size_t board = 0; board < numH * numV; ++board) {
+        size_t panelX, panelY;
+        switch(config.boardOrder) {
+            case MAX3000_ORDER_ROW_MAJOR_BOUNCE:
+                panelY = board / numH;
+                panelX = (panelY & 1) ? (numH - 1 - board % numH) : (board % numH);
+                break;
+            case MAX3000_ORDER_COL_MAJOR:
+                panelX = board / numV;
+                panelY = board % numV;
+                break;
+            case MAX3000_ORDER_COL_MAJOR_BOUNCE:
+                panelX = board / numV;
+                panelY = (panelX & 1) ? (numV - 1 - board % numV) : (board % numV);
+                break;
+            default:
+                panelX = board % numH;
+                panelY = board / numH;
+                break;
+        }
+
+        boardPanels[board]                  = panelY * numH + panelX;
+        panelBoards[panelY * numH + panelX] = board;
+        if(config.bufferLayout == MAX3000_LAYOUT_PANEL) {
+            boardOffsets[board] = board * PANEL_PENDING_BYTES;
+        } else {
+            boardOffsets[board] = panelX * PANEL_WIDTH + panelY * (PANEL_HEIGHT / 8) * config.width;
+        }
+        boardOrientation[board] = config.boardOrientations ? (config.boardOrientations[board] & MAX3000_ORIENT_ROTATE_180) : MAX3000_ORIENT_UPRIGHT;
+        boardTypes[board]       = (config.panelTypes && config.panelTypes[board]) ? config.panelTypes[board] : &MAX3000_PANEL_28X16;
+    }
+}
+
 void MAX3000_Base::drawPixel(int16_t x, int16_t y, uint16_t color) {
     if((x >= 0) && (x < localWidth) && (y >= 0) && (y < localHeight)) {
         // Pixel is in-bounds. Rotate coordinates if needed.
@@ -268,15 +334,17 @@ void MAX3000_Base::drawPixel(int16_t x, int16_t y, uint16_t color) {
                 break;
         }
 
+        markDirty(x, y, 1, 1);
+
         switch(color) {
             case MAX3000_LIGHT:
-                buffer[x + (y / 8) * config.width] |= (1 << (y & 7));
+                buffer[pixelOffset(x, y)] |= (1 << (y & 7));
                 break;
             case MAX3000_DARK:
-                buffer[x + (y / 8) * config.width] &= ~(1 << (y & 7));
+                buffer[pixelOffset(x, y)] &= ~(1 << (y & 7));
                 break;
             case MAX3000_INVERSE:
-                buffer[x + (y / 8) * config.width] ^= (1 << (y & 7));
+                buffer[pixelOffset(x, y)] ^= (1 << (y & 7));
                 break;
         }
     }
@@ -284,6 +352,33 @@ void MAX3000_Base::drawPixel(int16_t x, int16_t y, uint16_t color) {
 
 void MAX3000_Base::clearDisplay(void) {
     memset(buffer, 0, BUFFER_SIZE);
+    markAllDirty();
+}
+
+void MAX3000_Base::markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+    size_t firstBoardCol = x / PANEL_WIDTH;
+    size_t lastBoardCol  = (x + w - 1) / PANEL_WIDTH;
+    size_t firstBoardRow = y / PANEL_HEIGHT;
+    size_t lastBoardRow  = (y + h - 1) / PANEL_HEIGHT;
+
+    for(size_t boardRow = firstBoardRow; boardRow <= lastBoardRow; ++boardRow) {
+        for(size_t boardCol = firstBoardCol; boardCol <= lastBoardCol; ++boardCol) {
+            size_t board = panelBoards[boardRow * config.numHBoards + boardCol];
+            uint8_t first = (boardCol == firstBoardCol) ? (x % PANEL_WIDTH) : 0;
+            uint8_t last  = (boardCol == lastBoardCol) ? ((x + w - 1) % PANEL_WIDTH) : (PANEL_WIDTH - 1);
+            if(first < dirtyFirst[board]) {
+                dirtyFirst[board] = first;
+            }
+            if(last > dirtyLast[board]) {
+                dirtyLast[board] = last;
+            }
+        }
+    }
+}
+
+void MAX3000_Base::markAllDirty(void) {
+    memset(dirtyFirst, 0, config.numHBoards * config.numVBoards);
+    memset(dirtyLast, PANEL_WIDTH - 1, config.numHBoards * config.numVBoards);
 }
 
 bool MAX3000_Base::getPixel(int16_t x, int16_t y) {
@@ -303,7 +398,7 @@ bool MAX3000_Base::getPixel(int16_t x, int16_t y) {
                 y = config.height - y - 1;
                 break;
         }
-        return (buffer[x + (y / 8) * config.width] & (1 << (y & 7)));
+        return (buffer[pixelOffset(x, y)] & (1 << (y & 7)));
     }
     return false;    // Pixel out of bounds
 }
@@ -314,109 +409,590 @@ void MAX3000_Base::setUserLED(size_t board, bool state) {
 }
 
 uint8_t * MAX3000_Base::getBuffer(void) {
+    // Writes through the returned pointer can't be tracked, for as long as it's kept
+    bufferUntracked = true;
     return buffer;
 }
 
+void MAX3000_Base::releaseBuffer(void) {
+    // Writes made before releasing still have to be compared
+    if(bufferUntracked) {
+        markAllDirty();
+        bufferUntracked = false;
+    }
+}
+
+uint8_t * MAX3000_Base::getPanelBuffer(size_t board) {
+    if(config.bufferLayout != MAX3000_LAYOUT_PANEL || board >= config.numHBoards * config.numVBoards) {
+        return NULL;
+    }
+
+    dirtyFirst[board] = 0;
+    dirtyLast[board]  = PANEL_WIDTH - 1;
+    return &buffer[boardOffset(board)];
+}
+
 void MAX3000_Base::display(bool force) {
-    if(dissolveEnabled) {
-        // When dissolve mode is enabled, we want to update in a random order.
-        // To maintain the random appearance, we'll shuffle on each update.
-        shuffleIndex();
+    displayBegin(force);
+    while(displayStep(0xFFFFFFFFUL)) {
     }
+}
 
-    int numChanged = 0;
+void MAX3000_Base::displayBegin(bool force) {
+    checkCalibration();
+    if(frontBuffer != buffer) {
+        // Display the drawn frame, and continue drawing on the previous one.
+        uint8_t * drawn = buffer;
+        buffer          = frontBuffer;
+        frontBuffer     = drawn;
+    }
 
-    for(int i = 0; i < PANEL_HEIGHT * PANEL_WIDTH; ++i) {
-#if defined(ESP8266)
-        if(i == 0) {
-            yield();
+    // Custom scan orders can change their order without a change of
+    // settings, so their updates aren't cached.
+    if(planCache && !updateActive && !force && !firstUpdate && scanType != MAX3000_SCAN_CUSTOM) {
+        uint32_t fromHash     = MAX3000_Plan::hash(oldBuffer, BUFFER_SIZE);
+        uint32_t toHash       = MAX3000_Plan::hash(frontBuffer, BUFFER_SIZE);
+        MAX3000_Plan * cached = planCache->find(oldBuffer, frontBuffer, BUFFER_SIZE, fromHash, toHash, planSettings(), planCalibration());
+        if(cached && !cached->isValid()) {
+            if(planFrame(*cached, frontBuffer, false, fromHash, toHash)) {
+                // Used up like the order of any other update
+                if(dissolveEnabled) {
+                    nextDissolveOrder();
+                }
+            } else {
+                cached->clear();
+                cached = NULL;
+            }
         }
-#endif
 
-        // If dissolving, pick the shuffled index
-        int index = (dissolveEnabled) ? shuffledIndex[i] : i;
-
-        size_t col = (index / PANEL_HEIGHT);
-        size_t row = (index % PANEL_HEIGHT);
-
-        bool pixelsToSet[config.numHBoards * config.numVBoards];
-        bool pixelsToClear[config.numHBoards * config.numVBoards];
-        memset(pixelsToSet, 0, config.numHBoards * config.numVBoards * sizeof(bool));
-        memset(pixelsToClear, 0, config.numHBoards * config.numVBoards * sizeof(bool));
-
-        // First pass: Get the set/clear
-        // Since all boards share the same pulse lines, we have to figure out the
-        // required operation for every board first.
-        // Thus we just store what we want to do in an array, and then actually load
-        // and pulse once we've checked every board.
-        for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
-            size_t boardCol     = board % config.numHBoards;
-            size_t bufferOffset = (col + boardCol * PANEL_WIDTH) + ((row / 8) * config.numHBoards * PANEL_WIDTH);
-
-            bool newPixVal = buffer[bufferOffset] & (1 << (row & 7));
-            bool oldPixVal = oldBuffer[bufferOffset] & (1 << (row & 7));
-
-            // Check if we can skip the update.
-            // If it's the first update, we need to refresh everything.
-            if(!force && !firstUpdate && newPixVal == oldPixVal) {
-                continue;
-            }
+        if(cached) {
+            // The plan covers the whole frame, so only the drawn columns are left to catch up
+            catchUpBuffer();
+            beginPlan(cached);
+            return;
+        }
+    }
+
+    beginUpdate(frontBuffer, force, true);
+}
+
+bool MAX3000_Base::plan(MAX3000_Plan & out, bool force) {
+    return planFrame(out, buffer, force, MAX3000_Plan::hash(oldBuffer, BUFFER_SIZE), MAX3000_Plan::hash(buffer, BUFFER_SIZE));
+}
+
+bool MAX3000_Base::execute(const MAX3000_Plan & plan) {
+    if(updateActive || !plan.isValid() || plan.frameSize != BUFFER_SIZE ||
+        plan.numBoards != config.numHBoards * config.numVBoards) {
+        return false;
+    }
+    if((!plan.fromAny && memcmp(plan.from, oldBuffer, BUFFER_SIZE)) || plan.calibrationGeneration != planCalibration()) {
+        return false;
+    }
+
+    beginPlan(&plan);
+    while(displayStep(0xFFFFFFFFUL)) {
+    }
+    return true;
+}
+
+void MAX3000_Base::setPlanCache(MAX3000_PlanCache * cache) {
+    planCache = cache;
+}
+
+bool MAX3000_Base::displayStep(uint32_t budgetUs) {
+    uint32_t stepStart = transport->getMicros();
 
-            // Pre-select the decoder inputs for each board now.
-            selectRowColumn(board, row, col);
+    // Always send at least one pulse, so every step makes progress
+    while(pulseDirection) {
+        uint32_t pulseStart = transport->getMicros();
+        sendPulse();
 
-            bool setPixel        = (newPixVal != invertEnabled);
-            pixelsToSet[board]   = setPixel;
-            pixelsToClear[board] = !setPixel;
-            numChanged++;
+        // Stop if another pulse like this one wouldn't fit in the budget
+        uint32_t now = transport->getMicros();
+        if((uint32_t)(now - stepStart) + (uint32_t)(now - pulseStart) > budgetUs) {
+            break;
         }
+    }
+
+    if(updateActive && !pulseDirection) {
+        endUpdate();
+    }
+    return updateActive;
+}
 
-        // Second Pass: Turn on pixels that need to be set
-        // If no change is necessary for a board, neither row or column will
-        // be sourced and the pixel will remain in its existing state
-        bool setChanged = false;
-        for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
-            // Setting -> Row Set Source, Column sink
-            LOAD_SR(board, SR_PIN_COL_SOURCE, LOW);
-            LOAD_SR(board, SR_PIN_ROW_SOURCE, pixelsToSet[board]);
-            if(pixelsToSet[board]) setChanged = true;
+bool MAX3000_Base::isDisplayBusy(void) const {
+    return updateActive;
+}
+
+void MAX3000_Base::beginUpdate(const uint8_t * frame, bool force, bool tracked) {
+    // A new frame replaces the target of an update in progress
+    bool retarget = updateActive;
+    if(retarget && activePlan) {
+        // Replayed pulses don't track the physical state pixel by pixel, so
+        // the plan is finished before comparing against the new frame.
+        while(pulseDirection) {
+            sendPulse();
         }
-        if(setChanged) {
-            shiftRegWrite();
-            setPixel();
+        memcpy(oldBuffer, activePlan->frame, BUFFER_SIZE);
+        activePlan = NULL;
+    }
+    targetBuffer = frame;
+
+    if(!retarget) {
+        checkCalibration();
+        waitForFrame();
+        transport->frameBegin();
+        updateActive = true;
+
+        if(dissolveEnabled) {
+            // When dissolve mode is enabled, we want to update in a random order.
+            // To maintain the random appearance, each update gets a new order.
+            nextDissolveOrder();
         }
 
-        // Second Pass: Turn off pixels that need to be cleared
-        // If no change is necessary for a board, neither row or column will
-        // be sourced and the pixel will remain in its existing state
-        bool resetChanged = false;
-        for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
-            // Setting -> Row Set Source, Column sink
-            LOAD_SR(board, SR_PIN_COL_SOURCE, pixelsToClear[board]);
-            LOAD_SR(board, SR_PIN_ROW_SOURCE, LOW);
-            if(pixelsToClear[board]) resetChanged = true;
+#if defined(ESP8266)
+        yield();
+#endif
+    }
+
+    // Find the changed pixels of each board up front, so the pulse scheduling
+    // below only visits pixels that actually need a pulse.
+    diffBuffers(force, tracked, retarget);
+
+    // Each board walks its own update order, so a pulse can serve a pending
+    // pixel from every board at once, even if those pixels are at different
+    // positions on each panel. The number of pulses is the largest number of
+    // changes on any single board, instead of the union of changed positions.
+    scanStep = 0;
+    resetCursors();
+    if(pulseDirection) {
+        // When retargeting, the pulse already latched still goes out. The
+        // physical state already includes it, so it was accounted for by the diff.
+        return;
+    }
+
+    // Load and latch the first pulse, see sendPulse()
+    pulseDirection = loadNextPulse();
+    pulseWindow    = classWindow();
+    if(pulseDirection) {
+        shiftRegWrite();
+    }
+}
+
+void MAX3000_Base::beginPlan(const MAX3000_Plan * plan) {
+    waitForFrame();
+    transport->frameBegin();
+    updateActive = true;
+    activePlan   = plan;
+    planPulse    = 0;
+    targetBuffer = plan->frame;
+
+#if defined(ESP8266)
+    yield();
+#endif
+
+    // Load and latch the first pulse, see sendPulse()
+    pulseDirection = loadNextPulse();
+    pulseWindow    = classWindow();
+    if(pulseDirection) {
+        shiftRegWrite();
+    }
+}
+
+bool MAX3000_Base::planFrame(MAX3000_Plan & out, const uint8_t * frame, bool force, uint32_t fromHash, uint32_t toHash) {
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    if(updateActive || !out.reset(BUFFER_SIZE, numBoards)) {
+        return false;
+    }
+    checkCalibration();
+
+    memcpy(out.frame, frame, BUFFER_SIZE);
+    memcpy(out.from, oldBuffer, BUFFER_SIZE);
+    out.fromHash              = fromHash;
+    out.toHash                = toHash;
+    out.fromAny               = force || firstUpdate;
+    out.settings              = planSettings();
+    out.calibrationGeneration = planCalibration();
+
+    // Dissolve in the order the next update would use, without using it
+    // up, as the plan may never be executed.
+    uint32_t key = dissolveKey;
+    if(dissolveEnabled) {
+        nextDissolveOrder();
+    }
+
+    // Schedule the pulses exactly as an update would, but record them
+    // instead of sending them. The dirty columns are left for the next
+    // update, as the plan may never be executed.
+    planning     = true;
+    targetBuffer = out.frame;
+    diffBuffers(force, false, false);
+    scanStep = 0;
+    resetCursors();
+
+    bool ok = true;
+    uint8_t direction;
+    while(ok && (direction = loadNextPulse())) {
+        // The duration class rides in the upper bits of the direction
+        ok = out.addPulse(direction | (((pulseClass == CLASS_NONE) ? 0 : pulseClass) << 4), shiftReg);
+        out.pulseTime += classWindow() + 10;
+    }
+    planning    = false;
+    dissolveKey = key;
+
+    // Leave no pixel selected for the next shift
+    for(size_t board = 0; board < numBoards; ++board) {
+        LOAD_SR(board, SR_PIN_COL_SOURCE, false);
+        LOAD_SR(board, SR_PIN_ROW_SOURCE, false);
+    }
+    if(!ok) {
+        // Pending pixels of an incomplete plan would leak into a later retarget
+        memset(pending, 0, numBoards * PANEL_PENDING_BYTES);
+        out.clear();
+    }
+    return ok;
+}
+
+bool MAX3000_Base::estimateDisplayTime(MAX3000_TimeEstimate & estimate, bool force) {
+    if(updateActive) {
+        return false;
+    }
+
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    uint32_t classPulses[MAX3000_CALIBRATION_CLASSES];
+    uint32_t pulses = countPulses(buffer, force, classPulses);
+    uint32_t pinNs  = transport->estimatePinNs();
+
+    // The next words are shifted during each pulse, as many as fit in it,
+    // so shifting only adds time once it outlasts the pulse. The first
+    // words are shifted before the first pulse.
+    size_t chainBits    = numBoards * 16;
+    uint64_t chainNs    = transport->estimateShiftNs(chainBits);
+    uint64_t windowsNs  = 0;
+    uint64_t restsNs    = 0;
+    uint64_t lastRestNs = ~(uint64_t)0;
+    uint8_t numClasses  = calibration ? calibration->getClassCount() : 1;
+    for(uint8_t durationClass = 0; durationClass < numClasses; ++durationClass) {
+        if(!classPulses[durationClass]) {
+            continue;
+        }
+        uint64_t pulseNs  = (uint64_t)(calibration ? calibration->getClassDurationUs(durationClass) : pulseDuration) * 1000;
+        uint64_t restNs   = 0;
+        if(chainNs > pulseNs) {
+            restNs = transport->estimateShiftNs(chainBits - bitsWithin(pulseNs));
         }
-        if(resetChanged) {
-            shiftRegWrite();
-            clearPixel();
+        windowsNs += classPulses[durationClass] * pulseNs;
+        restsNs += classPulses[durationClass] * restNs;
+
+        // Nothing is shifted during the last pulse. Which class it is in
+        // isn't counted, so the smallest remainder is taken off.
+        if(restNs < lastRestNs) {
+            lastRestNs = restNs;
         }
     }
 
-    // Store current buffer to avoid unnecessary changes on next update.
-    memcpy(oldBuffer, buffer, BUFFER_SIZE);
-    firstUpdate = false;
+    uint64_t shiftNs    = pulses ? chainNs + restsNs - lastRestNs : 0;
+    uint64_t overheadNs = 0;
+    if(pulses) {
+        // Six enable writes and two 5us delays per pulse, and a latch of two writes before each pulse
+        overheadNs = pulses * (8 * (uint64_t)pinNs + 10000);
+    }
+
+    estimate.pulses     = pulses;
+    estimate.shiftUs    = shiftNs / 1000;
+    estimate.pulseUs    = windowsNs / 1000;
+    estimate.overheadUs = overheadNs / 1000 + getTimeToNextFrameUs();
+    estimate.totalUs    = estimate.shiftUs + estimate.pulseUs + estimate.overheadUs;
+    return true;
+}
+
+uint32_t MAX3000_Base::countPulses(const uint8_t * frame, bool force, uint32_t * classPulses) {
+    size_t numBoards   = config.numHBoards * config.numVBoards;
+    uint8_t invertMask = invertEnabled ? 0xFF : 0x00;
+
+    if(classPulses) {
+        memset(classPulses, 0, MAX3000_CALIBRATION_CLASSES * sizeof(uint32_t));
+    }
+
+    if(scanOrder || calibration) {
+        // Pulses per step or class depend on how the pixels of every board
+        // fall into them, so schedule the update without sending or recording it.
+        planning     = true;
+        targetBuffer = frame;
+        diffBuffers(force, false, false);
+        scanStep = 0;
+        resetCursors();
+
+        uint32_t pulses = 0;
+        while(loadNextPulse()) {
+            pulses++;
+            if(classPulses) {
+                classPulses[(pulseClass == CLASS_NONE) ? 0 : pulseClass]++;
+            }
+        }
+        planning = false;
+        return pulses;
+    }
+
+    // Every pulse takes the next pixel of each board that has one left, so
+    // the busiest board sets the number of pulses in each direction.
+    uint16_t maxSet = 0, maxClear = 0, maxBoth = 0;
+    for(size_t board = 0; board < numBoards; ++board) {
+        const uint8_t * boardFrame = &frame[boardOffset(board)];
+        const uint8_t * boardState = &oldBuffer[boardOffset(board)];
+        const uint8_t * present    = boardTypes[board]->present;
+        uint16_t set = 0, clear = 0;
+        for(size_t page = 0; page < PANEL_HEIGHT / 8; ++page) {
+            for(size_t col = 0; col < PANEL_WIDTH; ++col) {
+                size_t offset = page * pageStride + col;
+                uint8_t mask  = (force || firstUpdate) ? 0xFF : (boardFrame[offset] ^ boardState[offset]);
+                mask &= pgm_read_byte(&present[page * PANEL_WIDTH + col]);
+                if(mask) {
+                    uint8_t setBits = mask & (boardFrame[offset] ^ invertMask);
+                    set += __builtin_popcount(setBits);
+                    clear += __builtin_popcount(mask & ~setBits);
+                }
+            }
+        }
+        maxSet   = (set > maxSet) ? set : maxSet;
+        maxClear = (clear > maxClear) ? clear : maxClear;
+        maxBoth  = (set + clear > maxBoth) ? set + clear : maxBoth;
+    }
+
+    uint32_t pulses = (pulseMode == MAX3000_PULSE_COMBINED) ? maxBoth : maxSet + maxClear;
+    if(classPulses) {
+        classPulses[0] = pulses;
+    }
+    return pulses;
+}
+
+uint8_t MAX3000_Base::planSettings(void) const {
+    return pulseMode | (invertEnabled << 1) | (dissolveEnabled << 2) | (scanType << 3);
+}
+
+void MAX3000_Base::sendPulse(void) {
+    // The drivers only change their outputs on MTX_LAT, so the words for the
+    // next pulse are shifted in while the current pulse is running, and only
+    // the latch sits between two pulses. Shifting stops at the end of the
+    // pulse duration and finishes after the pulse, so pulses never stretch.
+    openPulse();
+    uint32_t remaining;
+    while((remaining = pulseRemainingUs()) && shiftPulseBits(remaining)) {
+    }
+
+    // Wait for the rest of the pulse duration
+    remaining = pulseRemainingUs();
+    if(remaining) {
+        transport->delayUs(remaining);
+    }
+    closePulse();
+    latchPulse();
+}
+
+void MAX3000_Base::openPulse(void) {
+    beginPulse(pulseDirection);
+    pulseStart     = transport->getMicros();
+    shiftDirection = loadNextPulse();
+    shiftWindow    = classWindow();
+    shiftBit       = 0;
+}
+
+uint32_t MAX3000_Base::pulseRemainingUs(void) {
+    uint32_t elapsed = transport->getMicros() - pulseStart;
+    return (elapsed < pulseWindow) ? (pulseWindow - elapsed) : 0;
+}
+
+bool MAX3000_Base::shiftPulseBits(uint32_t budgetUs) {
+    if(!isShiftPending()) {
+        return false;
+    }
+
+    // The clock is read once per call rather than once per bit. Transports
+    // that can't estimate shift a word per call.
+    size_t bits = transport->estimateShiftNs(16) ? bitsWithin((uint64_t)budgetUs * 1000) : 16;
+    if(!bits) {
+        return false;
+    }
+    transport->shiftBits(shiftReg, config.numHBoards * config.numVBoards, shiftBit, bits);
+    return true;
+}
+
+size_t MAX3000_Base::bitsWithin(uint64_t ns) {
+    uint32_t wordNs = transport->estimateShiftNs(16);
+    if(!wordNs) {
+        return 0;
+    }
+
+    // Transports sending whole words take as long for part of one
+    size_t bits = (ns * 16) / wordNs;
+    if(transport->estimateShiftNs(bits) > ns) {
+        bits &= ~(size_t)15;
+    }
+    return bits;
+}
 
-    if(constantRate) {
-        for(int i = numChanged; i < PANEL_HEIGHT * PANEL_WIDTH; ++i) {
+void MAX3000_Base::closePulse(void) {
+    endPulse(pulseDirection);
+}
+
+void MAX3000_Base::latchPulse(void) {
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    if(shiftDirection) {
+        transport->shiftBits(shiftReg, numBoards, shiftBit, numBoards * 16 - shiftBit);
+        transport->latch();
+    }
+    pulseDirection = shiftDirection;
+    pulseWindow    = shiftWindow;
+    shiftDirection = 0;
+}
+
+void MAX3000_Base::endUpdate(void) {
+    if(activePlan) {
+        memcpy(oldBuffer, activePlan->frame, BUFFER_SIZE);
+        activePlan = NULL;
+    }
+    updateActive = false;
+    firstUpdate  = false;
+    transport->frameEnd();
+}
+
+void MAX3000_Base::waitForFrame(void) {
+    if(!framePeriod) {
+        return;
+    }
+
+    // Wait in short chunks, as delayMicroseconds() is limited on some platforms
+    uint32_t wait = getTimeToNextFrameUs();
+    while(wait) {
+        uint32_t chunk = (wait > 1000) ? 1000 : wait;
+        transport->delayUs(chunk);
+        wait -= chunk;
 #if defined(ESP8266)
-            yield();
+        yield();
 #endif
-            shiftRegWrite();
-            delayMicroseconds(5);
-            delayMicroseconds(pulseDuration);
-            delayMicroseconds(5);
+    }
+
+    // Keep to the schedule, unless a whole period was missed
+    uint32_t now = transport->getMicros();
+    if(frameScheduled && (int32_t)(now - frameDeadline) < (int32_t)framePeriod) {
+        frameDeadline += framePeriod;
+    } else {
+        frameDeadline = now + framePeriod;
+    }
+    frameScheduled = true;
+}
+
+uint32_t MAX3000_Base::getTimeToNextFrameUs(void) {
+    if(!framePeriod || !frameScheduled) {
+        return 0;
+    }
+
+    int32_t early = (int32_t)(frameDeadline - transport->getMicros());
+    return (early > 0) ? early : 0;
+}
+
+uint8_t MAX3000_Base::loadNextPulse(void) {
+    size_t numBoards = config.numHBoards * config.numVBoards;
+
+    if(activePlan) {
+        // Replay the words of the plan, keeping each board's user LED
+        if(planPulse == activePlan->numPulses) {
+            for(size_t board = 0; board < numBoards; ++board) {
+                LOAD_SR(board, SR_PIN_COL_SOURCE, false);
+                LOAD_SR(board, SR_PIN_ROW_SOURCE, false);
+            }
+            return 0;
         }
+
+        const uint16_t * words = &activePlan->words[planPulse * numBoards];
+        for(size_t board = 0; board < numBoards; ++board) {
+            shiftReg[board] = (shiftReg[board] & (1 << SR_PIN_USER_LED)) | words[board];
+        }
+        uint8_t direction = activePlan->directions[planPulse++];
+        pulseClass        = direction >> 4;
+        return direction & (PULSE_SET | PULSE_CLEAR);
     }
+
+    pulseClass        = CLASS_NONE;
+    uint8_t direction = loadStepPulse();
+    while(!direction && scanOrder) {
+        // Every board is done with the step, so move on to the nearest
+        // step that any board still has pending pixels in.
+        uint16_t step = SCAN_NONE;
+        for(size_t board = 0; board < numBoards; ++board) {
+            if(scanNext[board] < step) {
+                step = scanNext[board];
+            }
+        }
+        if(step == SCAN_NONE) {
+            break;
+        }
+        scanStep = step;
+        resetCursors();
+        direction = loadStepPulse();
+    }
+    return direction;
+}
+
+uint8_t MAX3000_Base::loadStepPulse(void) {
+    return loadBoards<RuntimeGeometry>();
+}
+
+void MAX3000_Base::catchUpBuffer(void) {
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    for(size_t board = 0; board < numBoards; ++board) {
+        size_t first = bufferUntracked ? 0 : dirtyFirst[board];
+        size_t last  = bufferUntracked ? PANEL_WIDTH - 1 : dirtyLast[board];
+        dirtyFirst[board] = PANEL_WIDTH;
+        dirtyLast[board]  = 0;
+        if(buffer == frontBuffer || first > last) {
+            continue;
+        }
+
+        for(size_t page = 0; page < PANEL_HEIGHT / 8; ++page) {
+            size_t bufferOffset = boardOffset(board) + page * pageStride + first;
+            memcpy(&buffer[bufferOffset], &frontBuffer[bufferOffset], last - first + 1);
+        }
+    }
+}
+
+void MAX3000_Base::diffBuffers(bool force, bool tracked, bool retarget) {
+    diffBoards<RuntimeGeometry>(force, tracked, retarget);
+}
+
+void MAX3000_Base::resetCursors(void) {
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    for(size_t board = 0; board < numBoards; ++board) {
+        setCursor[board]   = 0;
+        clearCursor[board] = 0;
+        scanNext[board]    = SCAN_NONE;
+    }
+
+    if(calibration) {
+        memset(cursorClass, CLASS_NONE, numBoards * 2);
+        memset(classPassed, 0, numBoards * 2 * sizeof(uint16_t));
+    }
+
+    pendingDirections = PULSE_SET | PULSE_CLEAR;
+    nextDirection     = PULSE_SET;
+}
+
+bool MAX3000_Base::nextCursorClass(size_t slot, uint16_t & cursor) {
+    if(!classPassed[slot]) {
+        return false;
+    }
+
+    uint8_t slowest = CLASS_NONE;
+    for(uint8_t durationClass = 0; durationClass < MAX3000_CALIBRATION_CLASSES; ++durationClass) {
+        if((classPassed[slot] & (1 << durationClass)) &&
+            (slowest == CLASS_NONE || calibration->getClassDurationUs(durationClass) > calibration->getClassDurationUs(slowest))) {
+            slowest = durationClass;
+        }
+    }
+    cursorClass[slot] = slowest;
+    classPassed[slot] = 0;
+    cursor            = 0;
+    return true;
 }
 
 void MAX3000_Base::printDisplay(Stream & stream) {
@@ -442,9 +1018,7 @@ void MAX3000_Base::printDisplay(Stream & stream) {
             stream.print('|');
         }
 
-        size_t bufferOffset = col + (row / 8) * config.width;
-
-        uint8_t bufferVal = buffer[bufferOffset];
+        uint8_t bufferVal = buffer[pixelOffset(col, row)];
         bool pixVal       = bufferVal & (1 << (row & 7));
 
         if(pixVal) {
@@ -454,16 +1028,16 @@ void MAX3000_Base::printDisplay(Stream & stream) {
         }
 
         // If last column in board (or last column total), print closing border
-        if((col + 1) % PANEL_WIDTH == 0 || (uint8_t)col == (config.width - 1)) {
+        if((col + 1) % PANEL_WIDTH == 0 || col == (size_t)config.width - 1) {
             stream.print('|');
         }
 
         // If the last column total, print a newline
-        if((uint8_t)col == config.width - 1) {
+        if(col == (size_t)config.width - 1) {
             stream.println();
 
             // If last row in board (or last row total), print footer
-            if((row + 1) % PANEL_HEIGHT == 0 || (uint8_t)row == (config.height - 1)) {
+            if((row + 1) % PANEL_HEIGHT == 0 || row == (size_t)config.height - 1) {
                 for(size_t b = 0; b < config.numHBoards; ++b) {
                     stream.print('+');
                     for(size_t i = 0; i < (2 * config.width / config.numHBoards); ++i) {
@@ -511,91 +1085,162 @@ void MAX3000_Base::setDissolveEnable(bool param) {
     dissolveEnabled = param;
 }
 
-void MAX3000_Base::setPulseDurationUs(uint16_t param) {
-    pulseDuration = param;
+void MAX3000_Base::setDissolveSeed(uint32_t seed) {
+    dissolveKey = seed;
 }
 
-void MAX3000_Base::setConstantFrameRate(bool param) {
-    constantRate = param;
+void MAX3000_Base::setScanOrder(uint8_t type) {
+    if(type == MAX3000_SCAN_SEQUENTIAL || type == MAX3000_SCAN_CUSTOM) {
+        scanOrder = NULL;
+        scanType  = MAX3000_SCAN_SEQUENTIAL;
+        return;
+    }
+
+    builtinScan.type = type;
+    scanOrder        = &builtinScan;
+    scanType         = type;
 }
 
-void MAX3000_Base::selectRowColumn(size_t board, size_t row, size_t column) {    // TODO Board Order
-    // Map sequential rows and columns to the hardware pins
-    const uint8_t colToCode[] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12,
-        15, 14, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 };
-    const uint8_t rowToCode[] = { 14, 1, 15, 0, 12, 3, 13, 2, 10, 5, 11, 4, 8, 7, 9, 6 };
+void MAX3000_Base::setScanOrder(const MAX3000_ScanOrder * order) {
+    scanOrder = order;
+    scanType  = order ? MAX3000_SCAN_CUSTOM : MAX3000_SCAN_SEQUENTIAL;
+}
 
-    // Hack - Rows are reversed on the panel
-    row = 15 - row;
+void MAX3000_Base::setPulseDurationUs(uint16_t param) {
+    pulseDuration = param;
+    if(constantFrameRate) {
+        framePeriod = CONSTANT_FRAME_PERIOD;
+    }
+}
 
-    uint8_t rowSubCode = rowToCode[row] % 8;
-    uint8_t rowBank    = rowToCode[row] / 8;
+bool MAX3000_Base::setCalibration(const MAX3000_Calibration * calibration_) {
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    if(updateActive || (calibration_ && calibration_->getBoardCount() != numBoards)) {
+        return false;
+    }
 
-    uint8_t colSubCode = colToCode[column] % 8;
-    uint8_t colBank    = colToCode[column] / 8;
+    // Each board's set and clear cursors walk the classes on their own
+    if(calibration_) {
+        if((!cursorClass) && !(cursorClass = new uint8_t[numBoards * 2])) {
+            return false;
+        }
+        if((!classPassed) && !(classPassed = new uint16_t[numBoards * 2])) {
+            return false;
+        }
+    }
+    calibration = calibration_;
+    return true;
+}
 
-    LOAD_SR(board, SR_PIN_COL_A2, colSubCode & 0x4);
-    LOAD_SR(board, SR_PIN_COL_A1, colSubCode & 0x2);
-    LOAD_SR(board, SR_PIN_COL_A0, colSubCode & 0x1);
-    LOAD_SR(board, SR_PIN_ROW_A2, rowSubCode & 0x4);
-    LOAD_SR(board, SR_PIN_ROW_A1, rowSubCode & 0x2);
-    LOAD_SR(board, SR_PIN_ROW_A0, rowSubCode & 0x1);
-    LOAD_SR(board, SR_PIN_ROW_BANK, rowBank & 0x1);
-    LOAD_SR(board, SR_PIN_COL_BANK1, colBank & 0x2);
-    LOAD_SR(board, SR_PIN_COL_BANK0, colBank & 0x1);
+void MAX3000_Base::checkCalibration(void) {
+    if(calibration && calibration->getBoardCount() != config.numHBoards * config.numVBoards) {
+        calibration = NULL;
+    }
 }
 
-void MAX3000_Base::setPixel() {
-    // Global Pulse Enable
-    MAX3000_PULSE
+void MAX3000_Base::setConstantFrameRate(bool param) {
+    setFramePeriodUs(param ? CONSTANT_FRAME_PERIOD : 0);
+    constantFrameRate = param;
+}
 
-    // Turn on Source first, then Sink
-    MAX3000_PULSE_ROW
-    delayMicroseconds(5);
-    MAX3000_PULSE_COL
+void MAX3000_Base::setFramePeriodUs(uint32_t periodUs) {
+    framePeriod       = periodUs;
+    frameScheduled    = false;
+    constantFrameRate = false;
+}
 
-    // Wait for Pulse Duration
-    delayMicroseconds(pulseDuration);
+void MAX3000_Base::setPulseMode(uint8_t mode) {
+    pulseMode = mode;
+}
 
-    // Turn off Sink first, then Source
-    MAX3000_UNPULSE_COL
-    delayMicroseconds(5);
-    MAX3000_UNPULSE_ROW
+void MAX3000_Base::selectRowColumn(size_t board, size_t row, size_t column) {
+    // Merge the decoder inputs precomputed for the board's panel variant into
+    // its word, keeping the source and user LED bits. Mirrored panels select
+    // from the reversed tables.
+    const MAX3000_Panel * panel = boardTypes[board];
+    uint8_t orientation         = boardOrientation[board];
+    uint16_t colWord            = pgm_read_word(&panel->colWords[orientation & MAX3000_ORIENT_MIRROR_X][column]);
+    uint16_t rowWord            = pgm_read_word(&panel->rowWords[(orientation & MAX3000_ORIENT_MIRROR_Y) >> 1][row]);
+    shiftReg[board]             = (shiftReg[board] & ~ADDRESS_MASK) | colWord | rowWord;
+}
 
-    // Global Pulse Disable
-    MAX3000_UNPULSE
+uint8_t MAX3000_Base::pixelClass(size_t board, size_t row, size_t column) const {
+    // The bank bits of the words selecting the pixel, as in selectRowColumn()
+    const MAX3000_Panel * panel = boardTypes[board];
+    uint8_t orientation         = boardOrientation[board];
+    uint16_t colWord            = pgm_read_word(&panel->colWords[orientation & MAX3000_ORIENT_MIRROR_X][column]);
+    uint16_t rowWord            = pgm_read_word(&panel->rowWords[(orientation & MAX3000_ORIENT_MIRROR_Y) >> 1][row]);
+    uint8_t colBank             = ((colWord >> SR_PIN_COL_BANK0) & 1) | (((colWord >> SR_PIN_COL_BANK1) & 1) << 1);
+    uint8_t rowBank             = (rowWord >> SR_PIN_ROW_BANK) & 1;
+    return calibration->getClass(board, MAX3000_CALIBRATION_BANK(colBank, rowBank));
 }
 
-void MAX3000_Base::clearPixel() {
-    // Global Pulse Enable
-    MAX3000_PULSE
+uint16_t MAX3000_Base::classWindow(void) const {
+    return (calibration && pulseClass != CLASS_NONE) ? calibration->getClassDurationUs(pulseClass) : pulseDuration;
+}
 
-    // Turn on Source first, then Sink
-    MAX3000_PULSE_COL
-    delayMicroseconds(5);
-    MAX3000_PULSE_ROW
+void MAX3000_Base::beginPulse(uint8_t direction) {
+    switch(direction) {
+        case PULSE_SET:
+            // Global Pulse Enable
+            transport->setPulseEnable(true);
 
-    // Wait for Pulse Duration
-    delayMicroseconds(pulseDuration);
+            // Turn on Source first, then Sink
+            transport->setRowEnable(true);
+            transport->delayUs(5);
+            transport->setColEnable(true);
+            break;
+        case PULSE_CLEAR:
+            // Global Pulse Enable
+            transport->setPulseEnable(true);
+
+            // Turn on Source first, then Sink
+            transport->setColEnable(true);
+            transport->delayUs(5);
+            transport->setRowEnable(true);
+            break;
+        default:
+            // Some boards source the row and others the column, so neither enable can
+            // go first for both. Assert both with the global enable off, and let the
+            // global enable start and end the current for every board at once.
+            transport->setRowEnable(true);
+            transport->setColEnable(true);
+            transport->delayUs(5);
+            transport->setPulseEnable(true);
+            break;
+    }
+}
 
-    // Turn off Sink first, then Source
-    MAX3000_UNPULSE_ROW
-    delayMicroseconds(5);
-    MAX3000_UNPULSE_COL
+void MAX3000_Base::endPulse(uint8_t direction) {
+    switch(direction) {
+        case PULSE_SET:
+            // Turn off Sink first, then Source
+            transport->setColEnable(false);
+            transport->delayUs(5);
+            transport->setRowEnable(false);
 
-    // Global Pulse Disable
-    MAX3000_UNPULSE
+            // Global Pulse Disable
+            transport->setPulseEnable(false);
+            break;
+        case PULSE_CLEAR:
+            // Turn off Sink first, then Source
+            transport->setRowEnable(false);
+            transport->delayUs(5);
+            transport->setColEnable(false);
+
+            // Global Pulse Disable
+            transport->setPulseEnable(false);
+            break;
+        default:
+            transport->setPulseEnable(false);
+            transport->delayUs(5);
+            transport->setColEnable(false);
+            transport->setRowEnable(false);
+            break;
+    }
 }
 
-void MAX3000_Base::shuffleIndex() {
-    for(int i = 0; i < (int)(PANEL_HEIGHT * PANEL_WIDTH); i++) {
-#ifdef WIRINGPI
-        int n            = rand() % (PANEL_HEIGHT * PANEL_WIDTH);
-#else
-        int n            = random(0, PANEL_HEIGHT * PANEL_WIDTH);
-#endif
-        int temp         = shuffledIndex[n];
-        shuffledIndex[n] = shuffledIndex[i];
-        shuffledIndex[i] = temp;
-    }
+void MAX3000_Base::nextDissolveOrder(void) {
+    // A Weyl sequence never repeats a key within 2^32 updates
+    dissolveKey += 0x9E3779B9UL;
 }
@@ -25,47 +25,30 @@
 #ifndef _MAX3000_Lib_H_
 #define _MAX3000_Lib_H_
 
-#if defined(ARDUINO_STM32_FEATHER)
-typedef class HardwareSPI SPIClass;
-#endif
-
-// Arduino / Raspberry Pi specific includes and macros
-#ifndef WIRINGPI
-#include <Arduino.h>
-#include <SPI.h>
-#include <Wire.h>
-#else
-#include <MAX3000_Pi.h>
-#endif
-
-#if defined(__AVR__)
-typedef volatile uint8_t PortReg;
-typedef uint8_t PortMask;
-#define HAVE_PORTREG
-#elif defined(__SAM3X8E__)
-typedef volatile RwReg PortReg;
-typedef uint32_t PortMask;
-#define HAVE_PORTREG
-#elif(defined(__arm__) || defined(ARDUINO_FEATHER52)) && !defined(ARDUINO_ARCH_MBED) && !defined(ARDUINO_ARCH_RP2040)
-typedef volatile uint32_t PortReg;
-typedef uint32_t PortMask;
-#define HAVE_PORTREG
-#endif
-
-// TODO: PortReg is not working
-#undef HAVE_PORTREG
+#include <MAX3000_Calibration.h>
+#include <MAX3000_Panel.h>
+#include <MAX3000_Plan.h>
+#include <MAX3000_Scan.h>
+#include <MAX3000_Transport.h>
 
 #define MAX3000_DARK 0       // Draw 'off' pixels
 #define MAX3000_LIGHT 1      // Draw 'on' pixels
 #define MAX3000_INVERSE 2    // Invert pixels
 
+// Board 0 is the first board of the chain, and sits at the top left of the display in every order.
 #define MAX3000_ORDER_ROW_MAJOR 0           // Boards wired in rows
 #define MAX3000_ORDER_ROW_MAJOR_BOUNCE 1    // Boards wired in rows, moving backwards on every other row
 #define MAX3000_ORDER_COL_MAJOR 2           // Boards wired in columns
 #define MAX3000_ORDER_COL_MAJOR_BOUNCE 3    // Boards wired in columns, moving backwards on every other column
 
-#define PANEL_WIDTH 28     // Fixed number of columns in each MAX3000 panel
-#define PANEL_HEIGHT 16    // Fixed number of rows in each MAX3000 panel
+#define MAX3000_PULSE_SEPARATE 0    // Separate pulses for setting and clearing pixels
+#define MAX3000_PULSE_COMBINED 1    // Pixels being set and cleared share one pulse
+
+#define MAX3000_LAYOUT_PAGED 0    // Pages of 8 rows spanning the whole display, as on the SSD1306
+#define MAX3000_LAYOUT_PANEL 1    // Each panel stored as one contiguous block, in chain order
+
+#define MAX3000_BUFFER_SINGLE 0    // Drawing and display() share one frame buffer
+#define MAX3000_BUFFER_DOUBLE 1    // display() swaps in a separate front buffer, see bufferMode
 
 /**
  * @brief Configuration object for the MAX3000 library
@@ -80,10 +63,14 @@ class MAX3000_Config {
      * @param width_ If specified, sets the total width of the entire display in pixels.
      * @param height_ If specified, sets the total height of the entire display in pixels.
      */
-    MAX3000_Config(uint8_t width_ = 0, uint8_t height_ = 0)
+    MAX3000_Config(uint16_t width_ = 0, uint16_t height_ = 0)
         : width(((width_ + (PANEL_WIDTH - 1)) / PANEL_WIDTH) * PANEL_WIDTH),
           height(((height_ + (PANEL_HEIGHT - 1)) / PANEL_HEIGHT) * PANEL_HEIGHT),
           boardOrder(MAX3000_ORDER_ROW_MAJOR),
+          bufferLayout(MAX3000_LAYOUT_PAGED),
+          bufferMode(MAX3000_BUFFER_SINGLE),
+          boardOrientations(NULL),
+          panelTypes(NULL),
           mosi_pin(-1),
           sclk_pin(-1),
           lat_pin(-1),
@@ -92,7 +79,8 @@ class MAX3000_Config {
           col_pin(-1),
           row_pin(-1),
           spi(NULL),
-          spi_bitrate(65535UL) {
+          spi_bitrate(65535UL),
+          transport(NULL) {
         numHBoards = width / PANEL_WIDTH;
         numVBoards = height / PANEL_HEIGHT;
     }
@@ -113,7 +101,7 @@ class MAX3000_Config {
      * @param col_pin_ Pin number connected to the COL_ENABLE_N pin on the driver.
      * @param row_pin_ Pin number connected to the ROW_ENABLE_N pin on the driver.
      */
-    MAX3000_Config(uint8_t width_, uint8_t height_, SPIClass * spi_, int8_t lat_pin_, int8_t rst_pin_, int8_t pulse_pin_,
+    MAX3000_Config(uint16_t width_, uint16_t height_, SPIClass * spi_, int8_t lat_pin_, int8_t rst_pin_, int8_t pulse_pin_,
         int8_t col_pin_, int8_t row_pin_)
         : MAX3000_Config(width_, height_) {
         spi       = spi_;
@@ -140,7 +128,7 @@ class MAX3000_Config {
      * @param col_pin_ Pin number connected to the COL_ENABLE_N pin on the driver.
      * @param row_pin_ Pin number connected to the ROW_ENABLE_N pin on the driver.
      */
-    MAX3000_Config(uint8_t width_, uint8_t height_, int8_t mosi_pin_, int8_t sclk_pin_, int8_t lat_pin_,
+    MAX3000_Config(uint16_t width_, uint16_t height_, int8_t mosi_pin_, int8_t sclk_pin_, int8_t lat_pin_,
         int8_t rst_pin_, int8_t pulse_pin_, int8_t col_pin_, int8_t row_pin_)
         : MAX3000_Config(width_, height_) {
         mosi_pin  = mosi_pin_;
@@ -152,9 +140,27 @@ class MAX3000_Config {
         row_pin   = row_pin_;
     }
 
-    const uint8_t width;     // Total width of the combined display.
-    const uint8_t height;    // Total height of the combined display.
-    uint8_t boardOrder;      // Ordering of boards within the data chain.
+    const uint16_t width;    // Total width of the combined display.
+    const uint16_t height;   // Total height of the combined display.
+    uint8_t boardOrder;      // Ordering of boards within the data chain, one of MAX3000_ORDER_*.
+    uint8_t bufferLayout;    // Arrangement of pixels in the frame buffer, see getBuffer().
+
+    // With MAX3000_BUFFER_DOUBLE, display() swaps the drawing buffer with a
+    // front buffer that the update reads from, so drawing the next frame
+    // can't disturb the one being flipped. The new drawing buffer is brought
+    // up to date with the columns drawn since the last update, so it holds
+    // the submitted frame as in single buffered mode. Costs one more buffer.
+    uint8_t bufferMode;
+
+    // Orientation of each board in chain order, one of MAX3000_ORIENT_*, or
+    // NULL if all panels are upright. Read by begin(), so the array needn't
+    // outlive it. Panels aren't square, so they can't be turned by 90 degrees.
+    const uint8_t * boardOrientations;
+
+    // Panel variant of each board in chain order, see MAX3000_Panel.h, or
+    // NULL if all boards drive MAX3000_PANEL_28X16. Variants must outlive
+    // the display object, the array only begin().
+    const MAX3000_Panel * const * panelTypes;
     int8_t mosi_pin;         // Pin connected to MTX_DIN
     int8_t sclk_pin;         // Pin connected to MTX_CLK
     int8_t lat_pin;          // Pin connected to MTX_LAT
@@ -165,11 +171,26 @@ class MAX3000_Config {
     SPIClass * spi;          // SPI Hardware Instance
     uint32_t spi_bitrate;    // Bitrate of the SPI communications
 
+    // Optional transport used instead of driving the pins above directly.
+    // Must outlive the display object. See MAX3000_Transport.h.
+    MAX3000_Transport * transport;
+
     // Computed in constructor:
     size_t numHBoards;    // Number of horizontal boards in the total display matrix
     size_t numVBoards;    // Number of vertical boards in the total display matrix
 };
 
+/**
+ * @brief Predicted duration of an update, see MAX3000_Base::estimateDisplayTime()
+ */
+struct MAX3000_TimeEstimate {
+    uint32_t pulses;        // Number of pulses the update sends
+    uint32_t shiftUs;       // Shifting that doesn't overlap a pulse
+    uint32_t pulseUs;       // Pulse windows, including shifting done during them
+    uint32_t overheadUs;    // Waiting for the frame deadline, switching enables and latching
+    uint32_t totalUs;       // Sum of the above
+};
+
 /**
  * @brief Library for interacting with a MAX3000 Driver
  */
@@ -207,12 +228,118 @@ class MAX3000_Base {
      * Drawing operations are not visible until this function is
      * called. Call after each graphics command, or after a whole set
      * of graphics commands, as best needed by one's own application.
+     * An update started by \ref displayBegin is retargeted to the current
+     * frame and finished.
      *
      * @param force When true, sends a pulse for every pixel, instead of only
      *              pixels that have changed.
      */
     void display(bool force = false);
 
+    /**
+     * @brief Starts an update that is sent in steps by \ref displayStep.
+     *
+     * Computes pixels that have changed like \ref display, but returns
+     * before sending any pulses. Call \ref displayStep until it returns
+     * false to finish the update, leaving time for other work in between.
+     *
+     * If an update is already in progress, the new frame replaces its
+     * target: pixels not pulsed yet are compared again against the new
+     * frame, and pixels that reverted to their physical state are skipped.
+     * When frames are drawn faster than the panels flip, only the latest
+     * frame is shown, without flipping dots that would be overwritten.
+     *
+     * Drawing during the update is only isolated from it with
+     * MAX3000_BUFFER_DOUBLE, otherwise changes to pixels the update hasn't
+     * reached yet may or may not be shown until the next displayBegin().
+     *
+     * @param force When true, sends a pulse for every pixel, instead of only
+     *              pixels that have changed.
+     */
+    void displayBegin(bool force = false);
+
+    /**
+     * @brief Sends pulses of the update started by \ref displayBegin.
+     *
+     * Sends as many pulses as fit in the time budget, and then returns.
+     * At least one pulse is sent on each call, so a budget shorter than a
+     * pulse still makes progress.
+     *
+     * @param budgetUs Time to spend in microseconds.
+     * @return Returns true if the update still has pulses left to send.
+     */
+    bool displayStep(uint32_t budgetUs);
+
+    /**
+     * @brief Returns true while an update started by \ref displayBegin is in progress.
+     */
+    bool isDisplayBusy(void) const;
+
+    /**
+     * @brief Predicts the duration of the next call to \ref display.
+     *
+     * Counts the pulses needed for the current frame buffer, and times them
+     * with the pulse duration, the chain length and the shift and pin write
+     * costs reported by the transport, plus any wait for the frame period.
+     * The pulse count is exact. Time spent comparing and scheduling on the
+     * CPU isn't included, and the transport's costs are approximate on real
+     * hardware. A plan cache doesn't change the estimate, as cached updates
+     * send the same pulses.
+     *
+     * @param estimate Filled with the predicted duration.
+     * @param force When true, predicts a forced update.
+     * @return Returns false if an update is in progress.
+     */
+    bool estimateDisplayTime(MAX3000_TimeEstimate & estimate, bool force = false);
+
+    /**
+     * @brief Computes the update that \ref display would send, without sending it.
+     *
+     * Compares the drawing buffer against the physical state of the dots,
+     * and stores the shift register words and direction of every pulse in
+     * the plan, along with copies of the physical state and the frame. The plan can be sent with
+     * \ref execute while the dots are still in the same state, and its
+     * pulse count is known before anything is sent.
+     *
+     * @param out Plan to fill. Its memory is reused when planning again.
+     * @param force When true, sends a pulse for every pixel, instead of only
+     *              pixels that have changed.
+     * @return Returns false if an update is in progress or allocation failed.
+     */
+    bool plan(MAX3000_Plan & out, bool force = false);
+
+    /**
+     * @brief Sends an update computed by \ref plan, and waits until it is done.
+     *
+     * Only the stored words are sent, nothing is compared or scheduled. The
+     * dots then show the planned frame, whatever the drawing buffer holds.
+     *
+     * @param plan Plan to send.
+     * @return Returns false without sending anything if an update is in
+     *         progress, if the dots are no longer in the state the plan
+     *         was made for, or if the calibration changed since.
+     */
+    bool execute(const MAX3000_Plan & plan);
+
+    /**
+     * @brief Sets a cache of plans used by \ref display and \ref displayBegin.
+     *
+     * Each update is looked up by the physical state of the dots and the new
+     * frame. If the same transition was planned before, its pulses are
+     * replayed. A transition seen for the second time is planned into its
+     * entry first, and one seen for the first time is sent as usual, so
+     * frames that never repeat cost only hashing. Applications cycling
+     * through a few frames skip comparing and scheduling once every
+     * transition was seen twice.
+     *
+     * Forced updates, the first update and custom scan orders don't use the
+     * cache. A plan is replayed in the order it was made in, so dissolving
+     * repeats the same order for a transition.
+     *
+     * @param cache Cache to use, or NULL for none. Must outlive its use by the display.
+     */
+    void setPlanCache(MAX3000_PlanCache * cache);
+
     /**
      * @brief Prints a text-based representation of the current buffer.
      *
@@ -252,11 +379,41 @@ class MAX3000_Base {
     /**
      * @brief Get base address of display buffer for direct reading or writing.
      *
+     * Since writes through the pointer can't be tracked, every display()
+     * call from then on compares the whole display, until releaseBuffer() is
+     * called. With MAX3000_BUFFER_DOUBLE, display() swaps the buffers, so
+     * call getBuffer() again after it.
+     *
+     * With MAX3000_LAYOUT_PAGED, each byte holds 8 rows of one column, and
+     * each page of 8 rows spans the whole display width. With
+     * MAX3000_LAYOUT_PANEL, each panel is a block of PANEL_PENDING_BYTES in
+     * chain order, holding a page of rows 0-7 followed by a page of rows 8-15.
+     *
      * @return Pointer to an unsigned 8-bit array, column-major, columns padded
      * to full byte boundary if needed.
      */
     uint8_t * getBuffer(void);
 
+    /**
+     * @brief Tells the display that the pointer returned by getBuffer() is no longer written through.
+     *
+     * The next display() call still compares the whole display, and later
+     * ones only the pixels drawn since the previous update. Call getBuffer()
+     * again before writing to the buffer directly.
+     */
+    void releaseBuffer(void);
+
+    /**
+     * @brief Get address of the pixels of a single panel for direct reading or writing.
+     *
+     * Only available with MAX3000_LAYOUT_PANEL, where the panel is a single
+     * block of PANEL_PENDING_BYTES, laid out as described in \ref getBuffer.
+     *
+     * @param board Board Index, starting from 0
+     * @return Pointer to the block of the panel, or NULL if unavailable.
+     */
+    uint8_t * getPanelBuffer(size_t board);
+
     /**
      * @brief Enable or disable display invert mode (white-on-black vs black-on-white).
      *
@@ -299,6 +456,40 @@ class MAX3000_Base {
      */
     void setDissolveEnable(bool param);
 
+    /**
+     * @brief Sets the seed of the dissolve order
+     *
+     * Each update dissolves in a new order, different on every panel, and
+     * the sequence of orders is the same for a given seed. Takes effect from
+     * the next update.
+     *
+     * @param seed Seed of the sequence of dissolve orders
+     */
+    void setDissolveSeed(uint32_t seed);
+
+    /**
+     * @brief Sets the order in which updates flip pixels across the display
+     *
+     * With MAX3000_SCAN_SEQUENTIAL, every panel updates column by column at
+     * the same time, or in a random order when dissolving. The other orders
+     * are transition effects across the whole display, see MAX3000_Scan.h.
+     * They flip the changed pixels of one step at a time, so boards without
+     * pixels in the current step sit idle, and updates take more pulses.
+     * Within a step, pixels are taken in dissolve order when dissolving.
+     *
+     * @param type One of the MAX3000_SCAN_* values.
+     */
+    void setScanOrder(uint8_t type);
+
+    /**
+     * @brief Sets an order supplied by the application
+     *
+     * @param order Order to use, or NULL for MAX3000_SCAN_SEQUENTIAL. Must
+     *              outlive its use by the display. Plans made with one custom
+     *              order are reused from the cache with any other.
+     */
+    void setScanOrder(const MAX3000_ScanOrder * order);
+
     /**
      * @brief Sets the duration of each flip pulse in microseconds
      *
@@ -309,19 +500,81 @@ class MAX3000_Base {
     void setPulseDurationUs(uint16_t duration);
 
     /**
-     * @brief Sets whether each call to display() will take the same time
+     * @brief Sets a map of pulse durations per board and decoder bank
+     *
+     * Each pulse then only drives pixels of one duration class of the map,
+     * and lasts that class's duration instead of the one set with
+     * \ref setPulseDurationUs. See MAX3000_Calibration.h.
      *
-     * Normally, display() will only take as long as necessary to update
-     * the pixels that have changed. However if this is true, it will
-     * delay as necessary so that each call takes the same time.
-     * This constant frame rate is roughly equal to:
+     * @param calibration Map to use, or NULL for the same duration everywhere.
+     *                    Must outlive its use by the display, and not change
+     *                    during an update. Cached plans made before a change
+     *                    are planned again. A map begun again for another
+     *                    number of boards is dropped by the next update.
+     * @return Returns false if the map is for another number of boards, or an update is in progress.
+     */
+    virtual bool setCalibration(const MAX3000_Calibration * calibration);
+
+    /**
+     * @brief Sets whether updates start at a constant frame rate
+     *
+     * Normally, each update starts as soon as display() is called. However
+     * if this is true, updates are paced as with \ref setFramePeriodUs, with
+     * a period roughly equal to the longest update of a single panel:
      *     28 * 16 * (pulseDuration + 10 + 290) = 246ms = 4.1fps
+     * The period follows later calls to \ref setPulseDurationUs, until it is
+     * replaced with \ref setFramePeriodUs.
      *
      * @param param Whether constant frame rate should be used
      */
     void setConstantFrameRate(bool param);
 
+    /**
+     * @brief Sets the period between the starts of consecutive updates
+     *
+     * Each update is scheduled one period after the previous one started.
+     * display() and displayBegin() wait for that deadline before starting,
+     * while display() returns as soon as the pixels are flipped, so the time
+     * in between is left to the application. Deadlines are absolute, so
+     * a late update doesn't delay the ones after it, unless it is late by a
+     * whole period, in which case the schedule restarts.
+     *
+     * @param periodUs Period in microseconds, or 0 to start updates immediately.
+     */
+    void setFramePeriodUs(uint32_t periodUs);
+
+    /**
+     * @brief Returns the time left until the next update may start
+     *
+     * Lets cooperative main loops keep doing other work instead of waiting
+     * in display() or displayBegin().
+     *
+     * @return Time in microseconds, 0 if an update can start now.
+     */
+    uint32_t getTimeToNextFrameUs(void);
+
+    /**
+     * @brief Sets how pixels being set and cleared are grouped into pulses
+     *
+     * With MAX3000_PULSE_SEPARATE, each step of an update sends one pulse to
+     * set pixels and another to clear them. With MAX3000_PULSE_COMBINED, a
+     * board setting a pixel and a board clearing one share a single shift and
+     * pulse, as the direction is selected per board in its shift register.
+     * Combined pulses hold PULSE_ENABLE off while ROW_ENABLE_N and
+     * COL_ENABLE_N are asserted, so the same edges start and end the current
+     * in both directions. This only saves pulses where boards have pixels to
+     * set and pixels to clear pending in similar numbers: a step whose boards
+     * all flip the same way still takes one pulse either way.
+     *
+     * @param mode One of MAX3000_PULSE_SEPARATE or MAX3000_PULSE_COMBINED
+     */
+    void setPulseMode(uint8_t mode);
+
   protected:
+    friend class MAX3000_Engine;
+    friend class MAX3000_Scheduler;
+    friend class MAX3000_Wall;
+
     /**
      * @brief Constructs a new MAX3000_Base object.
      *
@@ -335,9 +588,7 @@ class MAX3000_Base {
     MAX3000_Base(const MAX3000_Config & config);
 
     /**
-     * @brief Writes shift register buffer out to display drivers.
-     *
-     * See HAVE_PORTREG which defines if the method uses a port or bit-bang method.
+     * @brief Writes shift register buffer out to display drivers and latches it.
      */
     inline void shiftRegWrite() __attribute__((always_inline));
 
@@ -351,19 +602,307 @@ class MAX3000_Base {
     void selectRowColumn(size_t board, size_t row, size_t column);
 
     /**
-     * Controls the various pulse lines in the correct order to turn bits on
+     * @brief Returns the offset in the frame buffer of the byte holding a pixel.
+     *
+     * @param x Column in the unrotated frame buffer.
+     * @param y Row in the unrotated frame buffer.
+     */
+    size_t pixelOffset(size_t x, size_t y) const {
+        if(config.bufferLayout == MAX3000_LAYOUT_PANEL) {
+            size_t board = panelBoards[(y / PANEL_HEIGHT) * config.numHBoards + (x / PANEL_WIDTH)];
+            return board * PANEL_PENDING_BYTES + ((y % PANEL_HEIGHT) / 8) * PANEL_WIDTH + (x % PANEL_WIDTH);
+        }
+        return x + (y / 8) * config.width;
+    }
+
+    /**
+     * @brief Returns the offset in the frame buffer of the first column of a board.
+     *
+     * The columns of each page of the board are consecutive, and pages are
+     * \ref pageStride bytes apart.
+     *
+     * @param board Board Index, starting from 0
+     */
+    size_t boardOffset(size_t board) const { return boardOffsets[board]; }
+
+    /**
+     * @brief Geometry of the display as configured at runtime, see MAX3000_Update.h
+     */
+    struct RuntimeGeometry {
+        // Whether the loops handle a calibration
+        static const bool CALIBRATED = true;
+
+        static size_t numBoards(const MAX3000_Base & base) { return base.config.numHBoards * base.config.numVBoards; }
+        static size_t boardOffset(const MAX3000_Base & base, size_t board) { return base.boardOffsets[board]; }
+        static size_t pageStride(const MAX3000_Base & base) { return base.pageStride; }
+        static size_t originX(const MAX3000_Base & base, size_t board) { return (base.boardPanels[board] % base.config.numHBoards) * PANEL_WIDTH; }
+        static size_t originY(const MAX3000_Base & base, size_t board) { return (base.boardPanels[board] / base.config.numHBoards) * PANEL_HEIGHT; }
+        static uint16_t width(const MAX3000_Base & base) { return base.config.width; }
+        static uint16_t height(const MAX3000_Base & base) { return base.config.height; }
+    };
+
+    /**
+     * @brief Computes the board mapping tables from the configured board order and orientations.
+     */
+    void mapBoards(void);
+
+    /**
+     * @brief Records that a rectangle of the frame buffer was written.
+     *
+     * Coordinates are in the unrotated frame buffer, and must already be clipped to it.
+     *
+     * @param x Left column of the rectangle.
+     * @param y Top row of the rectangle.
+     * @param w Width of the rectangle in pixels.
+     * @param h Height of the rectangle in pixels.
+     */
+    void markDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+
+    /**
+     * @brief Records that the whole frame buffer was written.
+     */
+    void markAllDirty(void);
+
+    /**
+     * @brief Starts an update showing a frame, sent with \ref displayStep.
+     *
+     * If an update is in progress, retargets it to the frame instead.
+     *
+     * @param frame Frame to show, laid out like \ref buffer. Must stay unchanged until the update is done.
+     * @param force When true, sends a pulse for every pixel.
+     * @param tracked When true, the frame is \ref frontBuffer and only the
+     *                columns marked dirty are compared. Otherwise the whole
+     *                frame is compared, and the dirty columns are left alone.
+     */
+    void beginUpdate(const uint8_t * frame, bool force, bool tracked);
+
+    /**
+     * @brief Starts an update replaying a plan, sent with \ref displayStep.
+     *
+     * @param plan Plan to replay. Must stay unchanged until the update is done.
+     */
+    void beginPlan(const MAX3000_Plan * plan);
+
+    /**
+     * @brief Computes the update from the physical state to a frame into a plan.
+     *
+     * @param out Plan to fill.
+     * @param frame Frame to show, laid out like \ref buffer.
+     * @param force When true, sends a pulse for every pixel.
+     * @param fromHash Hash of \ref oldBuffer, see MAX3000_Plan::hash().
+     * @param toHash Hash of frame.
+     * @return Returns false if an update is in progress or allocation failed.
+     */
+    bool planFrame(MAX3000_Plan & out, const uint8_t * frame, bool force, uint32_t fromHash, uint32_t toHash);
+
+    /**
+     * @brief Copies the columns drawn since the last update from \ref frontBuffer into \ref buffer.
+     *
+     * Only needed with double buffering, where the drawing buffer holds the
+     * frame before last. Resets the dirty columns of every board.
+     */
+    void catchUpBuffer(void);
+
+    /**
+     * @brief Counts the pulses of an update from the physical state to a frame.
+     *
+     * @param frame Frame to show, laid out like \ref buffer.
+     * @param force When true, counts the pulses of a forced update.
+     * @param classPulses If not NULL, receives the number of pulses of each
+     *                    duration class, MAX3000_CALIBRATION_CLASSES entries.
+     *                    Without a calibration, all pulses count in class 0.
+     */
+    uint32_t countPulses(const uint8_t * frame, bool force, uint32_t * classPulses = NULL);
+
+    /**
+     * @brief Returns the settings that affect which pulses an update sends.
+     *
+     * Plans made with other settings aren't reused from the cache.
+     */
+    uint8_t planSettings(void) const;
+
+    /**
+     * @brief Returns the generation of the calibration in use, or 0 without one.
+     *
+     * Plans made with other generations aren't reused from the cache, or executed.
+     */
+    uint32_t planCalibration(void) const { return calibration ? calibration->getGeneration() : 0; }
+
+    /**
+     * @brief Stops using a calibration begun again for another number of boards.
+     *
+     * The map is only checked by setCalibration() when it is set, so this is
+     * repeated before each update reads it.
+     */
+    void checkCalibration(void);
+
+    /**
+     * @brief Waits for the deadline of the next update, and schedules the one after it.
+     */
+    void waitForFrame(void);
+
+    /**
+     * @brief Sends the loaded pulse, while loading and latching the one after it.
+     */
+    void sendPulse(void);
+
+    /**
+     * @brief Starts the loaded pulse, and loads the words of the one after it.
+     *
+     * The pulse is split into \ref openPulse, \ref closePulse and
+     * \ref latchPulse, so MAX3000_Scheduler can work on other displays
+     * during the pulse window.
+     */
+    void openPulse(void);
+
+    /**
+     * @brief Returns the time left in the window of the pulse started by \ref openPulse.
+     */
+    uint32_t pulseRemainingUs(void);
+
+    /**
+     * @brief Shifts the bits of the next pulse that fit in a time budget.
+     *
+     * The number of bits comes from MAX3000_Transport::estimateShiftNs(), and
+     * all of them are shifted in one MAX3000_Transport::shiftBits() call.
+     *
+     * @param budgetUs Time available for shifting, in microseconds.
+     * @return Returns false if all bits were shifted already, or none fit.
+     */
+    bool shiftPulseBits(uint32_t budgetUs);
+
+    /**
+     * @brief Returns the number of bits the transport expects to shift in a duration.
+     *
+     * @return Number of bits, or 0 if the transport can't estimate.
+     */
+    size_t bitsWithin(uint64_t ns);
+
+    /**
+     * @brief Returns true while bits of the next pulse are left to shift.
+     */
+    bool isShiftPending(void) const { return shiftDirection && shiftBit < config.numHBoards * config.numVBoards * 16; }
+
+    /**
+     * @brief Ends the pulse started by \ref openPulse.
+     */
+    void closePulse(void);
+
+    /**
+     * @brief Shifts the remaining bits of the next pulse, and latches it.
+     */
+    void latchPulse(void);
+
+    /**
+     * @brief Completes the current update.
+     */
+    void endUpdate(void);
+
+    /**
+     * @brief Compares \ref targetBuffer against the physical state of the dots.
+     *
+     * Fills \ref pending with the pixels of each board that need a pulse, and
+     * counts them by direction in \ref pendingSet and \ref pendingClear.
+     *
+     * @param force When true, every pixel is considered changed.
+     * @param tracked When true, only the columns marked dirty since the last update are compared.
+     * @param retarget When true, pending pixels outside of the compared columns are kept.
+     */
+    virtual void diffBuffers(bool force, bool tracked, bool retarget);
+
+    /**
+     * @brief Body of \ref diffBuffers, with the geometry of a Geometry class, see MAX3000_Update.h.
+     */
+    template <class Geometry>
+    void diffBoards(bool force, bool tracked, bool retarget);
+
+    /**
+     * @brief Finds the next pixel on a board that needs a pulse in one direction.
+     *
+     * Advances the cursor through the board's update order (sequential, or
+     * a permutation of the board's pixels when dissolving), and loads the decoder inputs of the first
+     * pending pixel into the shift register buffer.
+     *
+     * With a calibration, the cursor goes through the order once per
+     * duration class of the board's pending pixels, slowest class first, so
+     * the slow pixels of every board share the same long pulses.
+     *
+     * @param board Board Index, starting from 0
+     * @param cursor Position in the board's update order, advanced past the returned pixel.
+     * @param directions Pulse directions to look for, PULSE_SET and/or PULSE_CLEAR.
+     * @return Direction of the selected pixel, or 0 if none was found.
      */
-    void setPixel();
+    template <class Geometry>
+    uint8_t nextPendingPixel(size_t board, uint16_t & cursor, uint8_t directions);
 
     /**
-     * Controls the various pulse lines in the correct order to turn bits off
+     * @brief Loads the shift register buffer with the next pulse of the update.
+     *
+     * Picks the next pending pixel of every board, see \ref setPulseMode.
+     * With a scan order, moves on to the next step once no board has pixels
+     * left in the current one. With a calibration, sets \ref pulseClass to
+     * the slowest class of the pixels in the pulse.
+     *
+     * Overridden by MAX3000_Stream, which sends its updates through the same
+     * pulse pipeline without a frame buffer.
+     *
+     * @return Direction of the pulse, PULSE_SET and/or PULSE_CLEAR, or 0 when the update is done.
      */
-    void clearPixel();
+    virtual uint8_t loadNextPulse(void);
 
     /**
-     * Shuffles the internal array of indexes.
+     * @brief Loads the shift register buffer with the next pulse of the current scan step.
+     *
+     * @return Direction of the pulse, or 0 when no board has pixels left in the step.
      */
-    void shuffleIndex();
+    virtual uint8_t loadStepPulse(void);
+
+    /**
+     * @brief Body of \ref loadStepPulse, with the geometry of a Geometry class, see MAX3000_Update.h.
+     */
+    template <class Geometry>
+    uint8_t loadBoards(void);
+
+    /**
+     * @brief Restarts every board's search for pending pixels from the start of its update order.
+     */
+    void resetCursors(void);
+
+    /**
+     * @brief Returns the duration class of a pixel, from the decoder banks selecting it.
+     */
+    uint8_t pixelClass(size_t board, size_t row, size_t column) const;
+
+    /**
+     * @brief Returns the window of the pulse just loaded by \ref loadNextPulse, in microseconds.
+     */
+    uint16_t classWindow(void) const;
+
+    /**
+     * @brief Moves a cursor on to the slowest duration class it passed over.
+     *
+     * @param slot Index of the cursor in \ref cursorClass.
+     * @param cursor Cursor, restarted from the beginning of the update order.
+     * @return Returns false if the cursor passed over no other class.
+     */
+    bool nextCursorClass(size_t slot, uint16_t & cursor);
+
+    /**
+     * @brief Controls the various pulse lines in the correct order to start a pulse.
+     * @param direction Direction returned by \ref loadNextPulse.
+     */
+    void beginPulse(uint8_t direction);
+
+    /**
+     * @brief Controls the various pulse lines in the correct order to end a pulse.
+     * @param direction Direction returned by \ref loadNextPulse.
+     */
+    void endPulse(uint8_t direction);
+
+    /**
+     * @brief Moves on to the next dissolve order.
+     */
+    void nextDissolveOrder(void);
 
     /**
      * @brief Set rotation setting for display
@@ -374,12 +913,21 @@ class MAX3000_Base {
     /** @brief Configuration of display drivers */
     MAX3000_Config config;
 
-    /** @brief Internal pixel memory buffer */
+    /** @brief Internal pixel memory buffer, drawn into by the application */
     uint8_t * buffer;
 
-    /** @brief The previous pixel memory buffer from the last display() call. */
+    /** @brief Frame being displayed. Same as \ref buffer unless double buffered. */
+    uint8_t * frontBuffer;
+
+    /** @brief Frame being sent to the dots by the current update */
+    const uint8_t * targetBuffer;
+
+    /** @brief Physical state of the dots, updated as each pixel is pulsed. */
     uint8_t * oldBuffer;
 
+    /** @brief Distance in bytes between the pages of 8 rows within a panel */
+    size_t pageStride;
+
     /** @brief Display width as modified by current rotation */
     int16_t localWidth;
 
@@ -392,33 +940,151 @@ class MAX3000_Base {
     /** @brief Duration of each pulse in microseconds */
     uint16_t pulseDuration;
 
+    /** @brief Pulse durations per board and bank, or NULL to use \ref pulseDuration everywhere */
+    const MAX3000_Calibration * calibration;
+
+    /** @brief Slowest duration class of the pixels in the pulse being loaded, CLASS_NONE if none */
+    uint8_t pulseClass;
+
+    /** @brief Per-board duration class walked by the set and clear cursors, CLASS_NONE before the first pass */
+    uint8_t * cursorClass;
+
+    /** @brief Per-board duration classes passed over by the set and clear cursors in their current pass */
+    uint16_t * classPassed;
+
+    /** @brief Window of the pulse loaded into the drivers in microseconds */
+    uint16_t pulseWindow;
+
+    /** @brief Window of the pulse being shifted in during the current one in microseconds */
+    uint16_t shiftWindow;
+
     /** @brief Whether or not the display should be white-on-black or not */
     bool invertEnabled;
 
     /** @brief When enabled, bits will flip in a random order instead of sequentially */
     bool dissolveEnabled;
 
-    /** @brief Whether constant frame rate is enabled */
-    bool constantRate;
+    /** @brief Period between the starts of updates in microseconds, 0 when not paced */
+    uint32_t framePeriod;
+
+    /** @brief Set when \ref framePeriod follows \ref pulseDuration, see setConstantFrameRate() */
+    bool constantFrameRate;
+
+    /** @brief Earliest start of the next update, valid when frameScheduled is set */
+    uint32_t frameDeadline;
+
+    /** @brief Whether frameDeadline holds a deadline */
+    bool frameScheduled;
+
+    /** @brief How set and clear pulses are grouped, see \ref setPulseMode */
+    uint8_t pulseMode;
+
+    /** @brief Pulse directions that may still have pixels pending in the current update */
+    uint8_t pendingDirections;
+
+    /** @brief Direction of the next pulse when set and clear pulses are separate */
+    uint8_t nextDirection;
+
+    /** @brief Direction of the pulse loaded into the drivers, or 0 when there are none left */
+    uint8_t pulseDirection;
+
+    /** @brief Direction of the pulse being shifted in during the current one, 0 if none */
+    uint8_t shiftDirection;
+
+    /** @brief Number of bits of the next pulse shifted so far */
+    size_t shiftBit;
+
+    /** @brief Time the current pulse started, from the transport's clock */
+    uint32_t pulseStart;
+
+    /** @brief Whether an update is in progress */
+    bool updateActive;
+
+    /** @brief Whether pulses are being scheduled into a plan, without changing the physical state */
+    bool planning;
+
+    /** @brief Plan replayed by the current update, or NULL when pulses are scheduled from the diff */
+    const MAX3000_Plan * activePlan;
+
+    /** @brief Index of the next pulse of \ref activePlan */
+    size_t planPulse;
+
+    /** @brief Cache of plans used by \ref displayBegin, or NULL for none */
+    MAX3000_PlanCache * planCache;
 
     /** @brief State flag that indicates when an update has not yet been done */
     bool firstUpdate;
 
-    /** @brief Array of length PIXEL_HEIGHT * PIXEL_WIDTH that maps indexes to a random number */
-    int * shuffledIndex;
+    /** @brief Set by getBuffer() until releaseBuffer(), makes every update compare the whole display */
+    bool bufferUntracked;
+
+    /** @brief Key of the dissolve order of the current update, advanced for every update */
+    uint32_t dissolveKey;
+
+    /** @brief Order of pixels across the display, or NULL for sequential updates */
+    const MAX3000_ScanOrder * scanOrder;
+
+    /** @brief Built-in order selected by \ref setScanOrder */
+    MAX3000_BuiltinScan builtinScan;
+
+    /** @brief MAX3000_SCAN_* value of \ref scanOrder */
+    uint8_t scanType;
+
+    /** @brief Step of the scan order whose pixels are being flipped */
+    uint16_t scanStep;
+
+    /** @brief Per-board lowest step after \ref scanStep found with pending pixels, SCAN_NONE if none */
+    uint16_t * scanNext;
 
     /** @brief Array with length of number of boards, storing the 16-bit shift register contents to send */
     uint16_t * shiftReg;
 
-#ifdef HAVE_PORTREG
-    PortReg *mosiPort, *clkPort, *latPort, *pulsePort, *rowPort, *colPort;
-    PortMask mosiPinMask, clkPinMask, latPinMask, pulsePinMask, rowPinMask, colPinMask;
-#endif
+    /** @brief Per-board position in the update order of the next pixel to set */
+    uint16_t * setCursor;
 
-#if defined(SPI_HAS_TRANSACTION)
-  protected:
-    SPISettings spiSettings;
-#endif
+    /** @brief Per-board position in the update order of the next pixel to clear */
+    uint16_t * clearCursor;
+
+    /**
+     * @brief Pixels of each board still needing a pulse in the current update.
+     *
+     * PANEL_PENDING_BYTES per board, in the same page layout as the frame
+     * buffer: one byte per column for rows 0-7, followed by rows 8-15.
+     */
+    uint8_t * pending;
+
+    /** @brief Per-board number of pending pixels to set */
+    uint16_t * pendingSet;
+
+    /** @brief Per-board number of pending pixels to clear */
+    uint16_t * pendingClear;
+
+    /** @brief Per-board offset in the frame buffer of the board's first column, see \ref boardOffset */
+    size_t * boardOffsets;
+
+    /** @brief Per-board position of the board's panel on the display, counted in rows of panels */
+    uint16_t * boardPanels;
+
+    /** @brief Board driving each panel position of the display, the inverse of \ref boardPanels */
+    uint16_t * panelBoards;
+
+    /** @brief Per-board orientation, one of MAX3000_ORIENT_*, applied when selecting rows and columns */
+    uint8_t * boardOrientation;
+
+    /** @brief Per-board panel variant, whose tables select rows and columns */
+    const MAX3000_Panel ** boardTypes;
+
+    /** @brief Per-board first column written since the last update, PANEL_WIDTH if none */
+    uint8_t * dirtyFirst;
+
+    /** @brief Per-board last column written since the last update */
+    uint8_t * dirtyLast;
+
+    /** @brief Built-in transport, used when the configuration doesn't supply one */
+    MAX3000_PinTransport pinTransport;
+
+    /** @brief Transport used for all pin and shift register access */
+    MAX3000_Transport * transport;
 };
 
 /**
@@ -0,0 +1,170 @@
+/**
+ * @file MAX3000_Panel.h
+ *
+ * Descriptions of the panel variants a MAX3000 driver can be wired to.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * The driver selects a dot with a column and a row decoder code, and each
+ * Luminator sign size wires its dots to different codes. A \ref MAX3000_Panel
+ * describes one variant: its size, the code driving each column and row, and
+ * which way the code tables run across the panel. MAX3000_makePanel() turns
+ * that into the shift register words of every column and row, for upright
+ * and mirrored mounting, at compile time, so a variant costs a table in flash
+ * and nothing while updating.
+ *
+ * Each board of a display occupies a PANEL_WIDTH x PANEL_HEIGHT cell of the
+ * frame buffer, whatever its variant. Smaller variants fill the top left of
+ * their cell, and the pixels outside them are never pulsed.
+ */
+
+#ifndef _MAX3000_Panel_H_
+#define _MAX3000_Panel_H_
+
+#include <MAX3000_Transport.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#elif defined(ESP8266) || defined(ESP32) || defined(ARDUINO_ARCH_RP2040)
+#include <pgmspace.h>
+#endif
+
+#ifndef pgm_read_byte
+#define pgm_read_byte(addr) (*(const unsigned char *)(addr))    ///< PROGMEM workaround for non-AVR
+#endif
+#ifndef pgm_read_word
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))    ///< PROGMEM workaround for non-AVR
+#endif
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+#define PANEL_WIDTH 28     // Number of columns in the frame buffer cell of each board
+#define PANEL_HEIGHT 16    // Number of rows in the frame buffer cell of each board
+
+#define PANEL_PENDING_BYTES (PANEL_WIDTH * PANEL_HEIGHT / 8)    // Size of the change mask of each panel
+
+#define MAX3000_ORIENT_UPRIGHT 0       // Panel mounted as designed
+#define MAX3000_ORIENT_MIRROR_X 1      // Panel mirrored left to right
+#define MAX3000_ORIENT_MIRROR_Y 2      // Panel mirrored top to bottom
+#define MAX3000_ORIENT_ROTATE_180 3    // Panel mounted upside down, mirrored both ways
+
+// Shift Register bit definitions on each driver
+#define SR_PIN_COL_A2 0
+#define SR_PIN_COL_A1 1
+#define SR_PIN_COL_A0 2
+#define SR_PIN_ROW_A0 3
+#define SR_PIN_ROW_A1 4
+#define SR_PIN_ROW_A2 5
+#define SR_PIN_ROW_BANK 6
+#define SR_PIN_COL_BANK0 7
+#define SR_PIN_COL_SOURCE 8
+#define SR_PIN_ROW_SOURCE 10
+#define SR_PIN_COL_BANK1 11
+#define SR_PIN_USER_LED 13
+
+// Shift register words driving the column and row decoders with a given code.
+// The lower three bits of a code select the decoder output, the upper bits the bank.
+#define MAX3000_COL_WORD(_c) ((((_c) >> 2) & 1) << SR_PIN_COL_A2 | (((_c) >> 1) & 1) << SR_PIN_COL_A1 | ((_c)&1) << SR_PIN_COL_A0 | \
+                              (((_c) >> 3) & 1) << SR_PIN_COL_BANK0 | (((_c) >> 4) & 1) << SR_PIN_COL_BANK1)
+#define MAX3000_ROW_WORD(_c) ((((_c) >> 2) & 1) << SR_PIN_ROW_A2 | (((_c) >> 1) & 1) << SR_PIN_ROW_A1 | ((_c)&1) << SR_PIN_ROW_A0 | \
+                              (((_c) >> 3) & 1) << SR_PIN_ROW_BANK)
+
+/**
+ * @brief Wiring of one panel variant, and the address words derived from it
+ *
+ * Build with MAX3000_makePanel(), and store with PROGMEM on AVR.
+ */
+struct MAX3000_Panel {
+    uint8_t width;          // Columns of the panel, at most PANEL_WIDTH
+    uint8_t height;         // Rows of the panel, at most PANEL_HEIGHT
+    uint8_t orientation;    // Direction of the code tables across the panel, one of MAX3000_ORIENT_*
+
+    // Decoder code of each column and row along the wiring, starting at the
+    // left and top edges unless the orientation mirrors them.
+    uint8_t colCodes[PANEL_WIDTH];
+    uint8_t rowCodes[PANEL_HEIGHT];
+
+    // Address words of each column and row of the cell, upright and mirrored
+    uint16_t colWords[2][PANEL_WIDTH];
+    uint16_t rowWords[2][PANEL_HEIGHT];
+
+    // Pixels of the cell the panel covers, in the layout of the change mask
+    uint8_t present[PANEL_PENDING_BYTES];
+};
+
+/** @cond INTERNAL */
+template <size_t... I>
+struct MAX3000_Indices {};
+
+template <size_t N, size_t... I>
+struct MAX3000_MakeIndices : MAX3000_MakeIndices<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MAX3000_MakeIndices<0, I...> {
+    typedef MAX3000_Indices<I...> type;
+};
+
+constexpr uint8_t MAX3000_panelCode(const uint8_t * codes, size_t length, size_t index) {
+    return (index < length) ? codes[index] : 0;
+}
+
+constexpr uint16_t MAX3000_panelColWord(const uint8_t * codes, size_t width, size_t col, uint8_t mirror) {
+    return (col < width) ? MAX3000_COL_WORD(codes[mirror ? (width - 1 - col) : col]) : 0;
+}
+
+constexpr uint16_t MAX3000_panelRowWord(const uint8_t * codes, size_t height, size_t row, uint8_t mirror) {
+    return (row < height) ? MAX3000_ROW_WORD(codes[mirror ? (height - 1 - row) : row]) : 0;
+}
+
+constexpr uint8_t MAX3000_panelPresent(size_t width, size_t height, size_t index) {
+    return ((index % PANEL_WIDTH) >= width || height <= (index / PANEL_WIDTH) * 8) ? 0
+           : (height >= (index / PANEL_WIDTH) * 8 + 8)                          ? 0xFF
+                                                                                  : (1 << (height % 8)) - 1;
+}
+
+template <size_t... C, size_t... R, size_t... P>
+constexpr MAX3000_Panel MAX3000_buildPanel(MAX3000_Indices<C...>, MAX3000_Indices<R...>, MAX3000_Indices<P...>,
+    uint8_t width, uint8_t height, const uint8_t * colCodes, const uint8_t * rowCodes, uint8_t orientation) {
+    return MAX3000_Panel { width, height, orientation,
+        { MAX3000_panelCode(colCodes, width, C)... },
+        { MAX3000_panelCode(rowCodes, height, R)... },
+        { { MAX3000_panelColWord(colCodes, width, C, orientation & MAX3000_ORIENT_MIRROR_X)... },
+            { MAX3000_panelColWord(colCodes, width, C, !(orientation & MAX3000_ORIENT_MIRROR_X))... } },
+        { { MAX3000_panelRowWord(rowCodes, height, R, orientation & MAX3000_ORIENT_MIRROR_Y)... },
+            { MAX3000_panelRowWord(rowCodes, height, R, !(orientation & MAX3000_ORIENT_MIRROR_Y))... } },
+        { MAX3000_panelPresent(width, height, P)... } };
+}
+/** @endcond */
+
+/**
+ * @brief Builds the description of a panel variant at compile time.
+ *
+ * Column codes are 5 bits, the decoder output and two bank bits, and row
+ * codes 4 bits, the decoder output and one bank bit.
+ *
+ * @param colCodes Decoder code of each column, width entries.
+ * @param rowCodes Decoder code of each row, height entries.
+ * @param orientation MAX3000_ORIENT_MIRROR_X if colCodes start at the right
+ *                    edge, and MAX3000_ORIENT_MIRROR_Y if rowCodes start at
+ *                    the bottom edge.
+ */
+template <size_t Width, size_t Height>
+constexpr MAX3000_Panel MAX3000_makePanel(const uint8_t (&colCodes)[Width], const uint8_t (&rowCodes)[Height],
+    uint8_t orientation) {
+    static_assert(Width <= PANEL_WIDTH && Height <= PANEL_HEIGHT, "Panel variant larger than a board's cell");
+    return MAX3000_buildPanel(typename MAX3000_MakeIndices<PANEL_WIDTH>::type(),
+        typename MAX3000_MakeIndices<PANEL_HEIGHT>::type(), typename MAX3000_MakeIndices<PANEL_PENDING_BYTES>::type(),
+        Width, Height, colCodes, rowCodes, orientation);
+}
+
+// Decoder codes of the 28 x 16 panel, rows listed from the bottom edge
+static constexpr uint8_t MAX3000_PANEL_28X16_COLS[] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12,
+    15, 14, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 };
+static constexpr uint8_t MAX3000_PANEL_28X16_ROWS[] = { 14, 1, 15, 0, 12, 3, 13, 2, 10, 5, 11, 4, 8, 7, 9, 6 };
+
+/** @brief Standard 28 x 16 panel, used for boards without a variant in MAX3000_Config::panelTypes */
+extern const MAX3000_Panel MAX3000_PANEL_28X16 PROGMEM;
+
+#endif    // _MAX3000_Panel_H_
@@ -1,6 +1,47 @@
 #ifdef WIRINGPI
 #include <MAX3000_Pi.h>
 
+#ifdef MAX3000_HOST_SIM
+#include <stdio.h>
+#include <time.h>
+
+static uint64_t hostNowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t hostEpochNs = hostNowNs();
+
+int wiringPiSetup(void) { return 0; }
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+void pwmWrite(int, int) {}
+
+void delay(unsigned int howLong)
+{
+  delayMicroseconds(howLong * 1000UL);
+}
+
+void delayMicroseconds(unsigned int howLong)
+{
+  struct timespec ts;
+  ts.tv_sec  = howLong / 1000000UL;
+  ts.tv_nsec = (howLong % 1000000UL) * 1000UL;
+  nanosleep(&ts, NULL);
+}
+
+unsigned int millis(void)
+{
+  return (unsigned int)((hostNowNs() - hostEpochNs) / 1000000ULL);
+}
+
+unsigned int micros(void)
+{
+  return (unsigned int)((hostNowNs() - hostEpochNs) / 1000ULL);
+}
+#endif
+
 /* default implementation: may be overridden */
 size_t Stream::write(const uint8_t *buffer, size_t size)
 {
@@ -1,7 +1,9 @@
 #ifndef _MAX3000_Pi_H_
 #define _MAX3000_Pi_H_
 
+#ifndef MAX3000_HOST_SIM
 #include <wiringPi.h>
+#endif
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -11,6 +13,26 @@
 
 typedef std::string String;
 
+#ifdef MAX3000_HOST_SIM
+// Stand-ins for the wiringPi API when building on a host without GPIO.
+// Pin writes are discarded, timing functions use the host clock.
+// Use together with MAX3000_SimTransport (MAX3000_Sim.h) to emulate a display.
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define PWM_OUTPUT 2
+
+int wiringPiSetup(void);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+void pwmWrite(int pin, int value);
+void delay(unsigned int howLong);
+void delayMicroseconds(unsigned int howLong);
+unsigned int millis(void);
+unsigned int micros(void);
+#endif
+
 class SPIClass {
   public:
     void begin() {}
@@ -0,0 +1,195 @@
+/**
+ * @file MAX3000_Plan.cpp
+ *
+ * Precomputed display updates, and a cache of them for repeated transitions.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#include <MAX3000_Lib.h>
+
+MAX3000_Plan::MAX3000_Plan(void)
+    : frame(NULL),
+      from(NULL),
+      frameSize(0),
+      numBoards(0),
+      words(NULL),
+      directions(NULL),
+      numPulses(0),
+      capacity(0),
+      fromHash(0),
+      toHash(0),
+      fromAny(false),
+      keyOnly(false),
+      settings(0),
+      calibrationGeneration(0),
+      pulseTime(0) {
+}
+
+MAX3000_Plan::~MAX3000_Plan(void) {
+    clear();
+}
+
+void MAX3000_Plan::clear(void) {
+    if(frame) {
+        free(frame);
+        frame = NULL;
+    }
+    if(from) {
+        free(from);
+        from = NULL;
+    }
+    if(words) {
+        free(words);
+        words = NULL;
+    }
+    if(directions) {
+        free(directions);
+        directions = NULL;
+    }
+    frameSize = 0;
+    numBoards = 0;
+    numPulses = 0;
+    capacity  = 0;
+    pulseTime = 0;
+    keyOnly   = false;
+}
+
+uint32_t MAX3000_Plan::hash(const uint8_t * data, size_t length) {
+    uint32_t h = 2166136261UL;
+    for(size_t i = 0; i < length; ++i) {
+        h = (h ^ data[i]) * 16777619UL;
+    }
+    return h;
+}
+
+bool MAX3000_Plan::reset(size_t frameSize_, size_t boards) {
+    // Pulses are stored per board, so they can't be reused for another chain
+    if(frameSize_ != frameSize || boards != numBoards) {
+        clear();
+    }
+    if((!frame) && !(frame = (uint8_t *)malloc(frameSize_))) {
+        return false;
+    }
+    if((!from) && !(from = (uint8_t *)malloc(frameSize_))) {
+        return false;
+    }
+    frameSize = frameSize_;
+    numBoards = boards;
+    numPulses = 0;
+    pulseTime = 0;
+    keyOnly   = false;
+    return true;
+}
+
+bool MAX3000_Plan::addPulse(uint8_t direction, const uint16_t * shiftReg) {
+    if(numPulses == capacity) {
+        // Grow geometrically, so planning stays linear in the number of pulses
+        size_t grown          = capacity ? capacity * 2 : 32;
+        uint16_t * grownWords = (uint16_t *)realloc(words, grown * numBoards * sizeof(uint16_t));
+        if(!grownWords) {
+            return false;
+        }
+        words = grownWords;
+
+        uint8_t * grownDirections = (uint8_t *)realloc(directions, grown);
+        if(!grownDirections) {
+            return false;
+        }
+        directions = grownDirections;
+        capacity   = grown;
+    }
+
+    // The user LED isn't part of the update, and is kept as set when replaying
+    uint16_t * pulseWords = &words[numPulses * numBoards];
+    for(size_t board = 0; board < numBoards; ++board) {
+        pulseWords[board] = shiftReg[board] & ~(1 << SR_PIN_USER_LED);
+    }
+    directions[numPulses++] = direction;
+    return true;
+}
+
+MAX3000_PlanCache::MAX3000_PlanCache(size_t capacity_)
+    : plans(NULL),
+      lastUse(NULL),
+      capacity(0),
+      useCount(0),
+      hits(0),
+      misses(0) {
+    plans   = new MAX3000_Plan[capacity_];
+    lastUse = new uint32_t[capacity_];
+    if(plans && lastUse) {
+        capacity = capacity_;
+        memset(lastUse, 0, capacity * sizeof(uint32_t));
+    }
+}
+
+MAX3000_PlanCache::~MAX3000_PlanCache(void) {
+    delete[] plans;
+    delete[] lastUse;
+}
+
+void MAX3000_PlanCache::clear(void) {
+    for(size_t i = 0; i < capacity; ++i) {
+        plans[i].clear();
+        lastUse[i] = 0;
+    }
+    useCount = 0;
+    hits     = 0;
+    misses   = 0;
+}
+
+MAX3000_Plan * MAX3000_PlanCache::find(const uint8_t * from, const uint8_t * frame, size_t frameSize, uint32_t fromHash,
+    uint32_t toHash, uint8_t settings, uint32_t calibrationGeneration) {
+    for(size_t i = 0; i < capacity; ++i) {
+        MAX3000_Plan & plan = plans[i];
+        if(plan.fromHash != fromHash || plan.toHash != toHash || plan.settings != settings ||
+            plan.calibrationGeneration != calibrationGeneration) {
+            continue;
+        }
+
+        // A repeated transition is planned now. A hash collision only costs
+        // planning a transition that doesn't repeat.
+        if(plan.keyOnly) {
+            lastUse[i] = ++useCount;
+            misses++;
+            return &plan;
+        }
+
+        // The hashes rule out most plans, and a full comparison the collisions,
+        // which would otherwise replay the pulses of another transition.
+        if(plan.isValid() && !plan.fromAny && plan.frameSize == frameSize && !memcmp(plan.from, from, frameSize) &&
+            !memcmp(plan.frame, frame, frameSize)) {
+            lastUse[i] = ++useCount;
+            hits++;
+            return &plan;
+        }
+    }
+
+    // Remember the transition, keeping the entry's memory for its plan
+    misses++;
+    MAX3000_Plan * seen = replace();
+    if(seen) {
+        seen->keyOnly               = true;
+        seen->fromHash              = fromHash;
+        seen->toHash                = toHash;
+        seen->settings              = settings;
+        seen->calibrationGeneration = calibrationGeneration;
+    }
+    return NULL;
+}
+
+MAX3000_Plan * MAX3000_PlanCache::replace(void) {
+    if(!capacity) {
+        return NULL;
+    }
+
+    size_t oldest = 0;
+    for(size_t i = 1; i < capacity; ++i) {
+        if(lastUse[i] < lastUse[oldest]) {
+            oldest = i;
+        }
+    }
+    lastUse[oldest] = ++useCount;
+    return &plans[oldest];
+}
@@ -0,0 +1,224 @@
+/**
+ * @file MAX3000_Plan.h
+ *
+ * Precomputed display updates, and a cache of them for repeated transitions.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * A \ref MAX3000_Plan holds the shift register words and pulse directions of
+ * one update, from a given physical state of the dots to a given frame, as
+ * computed by MAX3000_Base::plan(). Executing it only replays the words, with
+ * none of the comparing and scheduling of display().
+ *
+ * A \ref MAX3000_PlanCache keeps the most recently used plans, keyed by the
+ * physical state and the frame. Given to MAX3000_Base::setPlanCache(),
+ * display() plans a transition the second time it's seen, and replays the
+ * plan from then on, such as signage cycling through the same slides.
+ */
+
+#ifndef _MAX3000_Plan_H_
+#define _MAX3000_Plan_H_
+
+#include <MAX3000_Transport.h>
+
+/**
+ * @brief Shift register words and pulse directions of one display update
+ */
+class MAX3000_Plan {
+  public:
+    /**
+     * @brief Constructs an empty plan.
+     */
+    MAX3000_Plan(void);
+
+    /**
+     * @brief Destructor, frees the plan's memory.
+     */
+    ~MAX3000_Plan(void);
+
+    /**
+     * @brief Returns true if the plan holds an update.
+     */
+    bool isValid(void) const { return frame != NULL && numBoards != 0 && !keyOnly; }
+
+    /**
+     * @brief Returns the number of pulses sent by the update.
+     */
+    size_t getPulseCount(void) const { return numPulses; }
+
+    /**
+     * @brief Returns the time spent in pulses by the update, in microseconds.
+     *
+     * Counts the pulse durations when the plan was made, each pulse's own
+     * with a calibration, plus switching the enables around each pulse. Shifting happens during the pulses, so
+     * this is the duration of the whole update, unless shifting the chain
+     * takes longer than a pulse.
+     */
+    uint32_t getPulseTimeUs(void) const { return pulseTime; }
+
+    /**
+     * @brief Frees the plan's memory.
+     */
+    void clear(void);
+
+    /**
+     * @brief Computes a 32-bit FNV-1a hash of a frame buffer.
+     *
+     * @param data Frame buffer to hash.
+     * @param length Length of the frame buffer in bytes.
+     */
+    static uint32_t hash(const uint8_t * data, size_t length);
+
+  protected:
+    friend class MAX3000_Base;
+    friend class MAX3000_PlanCache;
+
+    /**
+     * @brief Allocates the frame and physical state, and empties the list of pulses.
+     *
+     * @param frameSize Size of the frame buffer in bytes.
+     * @param boards Number of boards in the chain.
+     * @return Returns true on successful allocation.
+     */
+    bool reset(size_t frameSize, size_t boards);
+
+    /**
+     * @brief Appends a pulse.
+     *
+     * @param direction Direction of the pulse.
+     * @param shiftReg Shift register words of the pulse, one per board.
+     * @return Returns true on successful allocation.
+     */
+    bool addPulse(uint8_t direction, const uint16_t * shiftReg);
+
+    /** @brief Frame shown once the update is done */
+    uint8_t * frame;
+
+    /** @brief Physical state the update starts from, the size of \ref frame */
+    uint8_t * from;
+
+    /** @brief Size of the frame in bytes */
+    size_t frameSize;
+
+    /** @brief Number of boards in the chain the plan was made for */
+    size_t numBoards;
+
+    /** @brief Shift register words of each pulse, numBoards per pulse, without the user LED bit */
+    uint16_t * words;
+
+    /** @brief Direction of each pulse, with its duration class in the upper four bits */
+    uint8_t * directions;
+
+    /** @brief Number of pulses in the plan */
+    size_t numPulses;
+
+    /** @brief Number of pulses that fit in words and directions */
+    size_t capacity;
+
+    /** @brief Hash of the physical state the update starts from */
+    uint32_t fromHash;
+
+    /** @brief Hash of \ref frame */
+    uint32_t toHash;
+
+    /** @brief Whether every pixel is pulsed, so the update applies to any physical state */
+    bool fromAny;
+
+    /** @brief Whether only the hashes, settings and calibration of a transition seen once are set */
+    bool keyOnly;
+
+    /** @brief Display settings the pulses were scheduled with, see MAX3000_Base::planSettings() */
+    uint8_t settings;
+
+    /** @brief Generation of the calibration the pulses were grouped by, or 0 without one */
+    uint32_t calibrationGeneration;
+
+    /** @brief Time spent in pulses, as returned by getPulseTimeUs() */
+    uint32_t pulseTime;
+};
+
+/**
+ * @brief Least recently used cache of display update plans
+ */
+class MAX3000_PlanCache {
+  public:
+    /**
+     * @brief Constructs a cache holding a number of plans.
+     *
+     * Each plan holds copies of the physical state it starts from and of its
+     * frame, plus two bytes per board for each pulse of its update, allocated
+     * as the plan is made.
+     *
+     * @param capacity Number of plans to keep. Use at least the number of
+     *                 transitions that repeat, such as one per slide.
+     */
+    MAX3000_PlanCache(size_t capacity = 4);
+
+    /**
+     * @brief Destructor, frees all plans.
+     */
+    ~MAX3000_PlanCache(void);
+
+    /**
+     * @brief Frees all plans, and resets the statistics.
+     */
+    void clear(void);
+
+    /**
+     * @brief Returns the number of updates served by a cached plan.
+     */
+    uint32_t getHits(void) const { return hits; }
+
+    /**
+     * @brief Returns the number of updates not served by a cached plan.
+     */
+    uint32_t getMisses(void) const { return misses; }
+
+  protected:
+    friend class MAX3000_Base;
+
+    /**
+     * @brief Finds the plan of a transition, and marks it as used.
+     *
+     * A transition seen for the first time only has its key stored, in the
+     * least recently used entry, so frames that never repeat cost no copies.
+     * When it's seen again, its entry is returned without a plan, to plan
+     * the update into.
+     *
+     * @param from Physical state of the dots.
+     * @param frame Frame to show.
+     * @param frameSize Size of the frame in bytes.
+     * @param fromHash Hash of from, see MAX3000_Plan::hash().
+     * @param toHash Hash of frame.
+     * @param settings Current display settings, see MAX3000_Base::planSettings().
+     * @param calibrationGeneration Generation of the current calibration, or 0 without one.
+     * @return The plan, the entry to plan a repeated transition into, or NULL.
+     */
+    MAX3000_Plan * find(const uint8_t * from, const uint8_t * frame, size_t frameSize, uint32_t fromHash,
+        uint32_t toHash, uint8_t settings, uint32_t calibrationGeneration);
+
+    /**
+     * @brief Returns the least recently used plan to replace, and marks it as used.
+     */
+    MAX3000_Plan * replace(void);
+
+    /** @brief Cached plans */
+    MAX3000_Plan * plans;
+
+    /** @brief Value of useCount when each plan was last used */
+    uint32_t * lastUse;
+
+    /** @brief Number of plans */
+    size_t capacity;
+
+    /** @brief Counter of plan uses, to find the least recently used */
+    uint32_t useCount;
+
+    /** @brief Number of updates served by a cached plan */
+    uint32_t hits;
+
+    /** @brief Number of updates not served by a cached plan */
+    uint32_t misses;
+};
+
+#endif    // _MAX3000_Plan_H_
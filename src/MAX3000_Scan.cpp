@@ -0,0 +1,58 @@
+/**
+ * @file MAX3000_Scan.cpp
+ *
+ * Orders in which display updates flip the pixels of the whole display.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#include <MAX3000_Lib.h>
+
+#define SPIRAL_PITCH 8    // Distance in pixels between the turns of the spiral
+
+uint16_t MAX3000_BuiltinScan::step(uint16_t x, uint16_t y, uint16_t width, uint16_t height) const {
+    // Offsets from the center in half pixels. Displays are whole panels, so
+    // their dimensions are even and the offsets are never zero.
+    int16_t sx  = 2 * x + 1 - width;
+    int16_t sy  = 2 * y + 1 - height;
+    uint16_t ax = (sx < 0) ? -sx : sx;
+    uint16_t ay = (sy < 0) ? -sy : sy;
+
+    // Octagonal approximation of the distance from the center, in pixels
+    uint16_t radius = ((ax > ay) ? (ax + ay / 2) : (ay + ax / 2)) / 2;
+
+    switch(type) {
+        case MAX3000_SCAN_WIPE_RIGHT:
+            return x;
+        case MAX3000_SCAN_WIPE_LEFT:
+            return width - 1 - x;
+        case MAX3000_SCAN_WIPE_DOWN:
+            return y;
+        case MAX3000_SCAN_WIPE_UP:
+            return height - 1 - y;
+        case MAX3000_SCAN_CENTER_OUT:
+            return radius;
+        case MAX3000_SCAN_DIAGONAL:
+            return x + y;
+        case MAX3000_SCAN_TEXT:
+            return (y / PANEL_HEIGHT) * width + x;
+        case MAX3000_SCAN_SPIRAL: {
+            // Angle from 0 to 63, clockwise from the top, measured along a
+            // diamond instead of a circle to avoid trigonometry.
+            uint16_t sum = ax + ay;
+            uint8_t angle;
+            if(sy >= 0) {
+                angle = (sx > 0) ? (16 * ay / sum) : (16 + 16 * ax / sum);
+            } else {
+                angle = (sx <= 0) ? (32 + 16 * ay / sum) : (48 + 16 * ax / sum);
+            }
+            angle = (angle + 16) & 63;
+
+            // Pixels on one step form an arm that reaches SPIRAL_PITCH pixels
+            // further out with every turn, and grows outward with each step.
+            return radius + (uint16_t)angle * SPIRAL_PITCH / 64;
+        }
+        default:
+            return 0;
+    }
+}
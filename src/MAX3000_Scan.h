@@ -0,0 +1,84 @@
+/**
+ * @file MAX3000_Scan.h
+ *
+ * Orders in which display updates flip the pixels of the whole display.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * A \ref MAX3000_ScanOrder assigns each pixel of the display a step. Updates
+ * flip all changed pixels of one step before moving on to the next step, so
+ * the order shows as a transition effect, such as a wipe across the display.
+ * Boards with pixels in the same step flip them in parallel, and steps
+ * without any changed pixels are skipped. Steps are computed on the fly
+ * from the pixel coordinates, so orders need no memory of their own.
+ *
+ * The built-in orders are provided by \ref MAX3000_BuiltinScan, selected with
+ * MAX3000_Base::setScanOrder() and one of the MAX3000_SCAN_* values.
+ */
+
+#ifndef _MAX3000_Scan_H_
+#define _MAX3000_Scan_H_
+
+#include <MAX3000_Transport.h>
+
+#define MAX3000_SCAN_SEQUENTIAL 0    // Each panel column by column, all panels at once (default)
+#define MAX3000_SCAN_WIPE_RIGHT 1    // Column by column across the display, from the left edge
+#define MAX3000_SCAN_WIPE_LEFT 2     // Column by column across the display, from the right edge
+#define MAX3000_SCAN_WIPE_DOWN 3     // Row by row down the display, from the top edge
+#define MAX3000_SCAN_WIPE_UP 4       // Row by row up the display, from the bottom edge
+#define MAX3000_SCAN_SPIRAL 5        // A spiral arm turning clockwise out of the center
+#define MAX3000_SCAN_CENTER_OUT 6    // Rings growing out of the center
+#define MAX3000_SCAN_DIAGONAL 7      // Diagonal lines from the top left corner to the bottom right
+#define MAX3000_SCAN_TEXT 8          // Column by column along each row of panels, then the next row, like reading
+
+#define MAX3000_SCAN_CUSTOM 15    // Order supplied by the application
+
+/**
+ * @brief Order in which updates flip the pixels of the display
+ */
+class MAX3000_ScanOrder {
+  public:
+    /**
+     * @brief Virtual Destuctor
+     */
+    virtual ~MAX3000_ScanOrder(void) {}
+
+    /**
+     * @brief Returns the step in which a pixel is flipped.
+     *
+     * Pixels are flipped in order of increasing step, and pixels sharing a
+     * step are flipped together as far as the boards allow. Called for each
+     * changed pixel as updates search for the next one, so keep it cheap.
+     *
+     * Coordinates are in the unrotated frame buffer.
+     *
+     * @param x Column of the pixel.
+     * @param y Row of the pixel.
+     * @param width Width of the display in pixels.
+     * @param height Height of the display in pixels.
+     * @return Step of the pixel, up to 0xFFFE.
+     */
+    virtual uint16_t step(uint16_t x, uint16_t y, uint16_t width, uint16_t height) const = 0;
+};
+
+/**
+ * @brief Built-in transition orders, see the MAX3000_SCAN_* values
+ */
+class MAX3000_BuiltinScan : public MAX3000_ScanOrder {
+  public:
+    /**
+     * @brief Constructs a built-in order.
+     *
+     * @param type One of the MAX3000_SCAN_* values, other than MAX3000_SCAN_SEQUENTIAL.
+     */
+    MAX3000_BuiltinScan(uint8_t type = MAX3000_SCAN_WIPE_RIGHT)
+        : type(type) {
+    }
+
+    virtual uint16_t step(uint16_t x, uint16_t y, uint16_t width, uint16_t height) const;
+
+    /** @brief One of the MAX3000_SCAN_* values */
+    uint8_t type;
+};
+
+#endif    // _MAX3000_Scan_H_
@@ -0,0 +1,142 @@
+/**
+ * @file MAX3000_Scheduler.cpp
+ *
+ * Interleaved updates of several displays driven from one CPU.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#include <MAX3000_Scheduler.h>
+
+// Phases of each display's update
+#define PHASE_READY 0       // Next pulse latched, or none left
+#define PHASE_PULSING 1     // Pulse window open, next pulse being shifted
+#define PHASE_LATCHING 2    // Pulse window closed, next pulse still being shifted
+#define PHASE_DONE 3        // Update finished
+#define PHASE_WAITING 4     // Update not started, frame period not over yet
+
+MAX3000_Scheduler::MAX3000_Scheduler(void)
+    : numDisplays(0),
+      forced(false) {
+}
+
+bool MAX3000_Scheduler::add(MAX3000_Base & display) {
+    if(numDisplays == MAX3000_SCHEDULER_MAX_DISPLAYS) {
+        return false;
+    }
+    displays[numDisplays] = &display;
+    phases[numDisplays++] = PHASE_DONE;
+    return true;
+}
+
+void MAX3000_Scheduler::display(bool force) {
+    // Updates start in step(), each once its frame period is over
+    forced = force;
+    for(size_t i = 0; i < numDisplays; ++i) {
+        phases[i] = PHASE_WAITING;
+    }
+    while(step()) {
+    }
+}
+
+bool MAX3000_Scheduler::step(void) {
+    // End windows that are due first, so pulses stretch as little as possible
+    bool busy             = false;
+    bool windowOpen       = false;
+    uint32_t wait         = 0;
+    MAX3000_Base * waiter = NULL;
+    for(size_t i = 0; i < numDisplays; ++i) {
+        if(phases[i] == PHASE_PULSING) {
+            uint32_t remaining = displays[i]->pulseRemainingUs();
+            if(!remaining) {
+                displays[i]->closePulse();
+                phases[i] = PHASE_LATCHING;
+            } else if(!waiter || remaining < wait) {
+                wait   = remaining;
+                waiter = displays[i];
+            }
+        }
+    }
+
+    // Start the updates that are due, without waiting for the others
+    uint32_t frameWait         = 0;
+    MAX3000_Base * frameWaiter = NULL;
+    for(size_t i = 0; i < numDisplays; ++i) {
+        if(phases[i] == PHASE_WAITING) {
+            uint32_t early = displays[i]->getTimeToNextFrameUs();
+            if(!early) {
+                displays[i]->displayBegin(forced);
+                phases[i] = PHASE_READY;
+            } else if(!frameWaiter || early < frameWait) {
+                frameWait   = early;
+                frameWaiter = displays[i];
+            }
+        }
+    }
+
+    // Start every pulse that is latched
+    for(size_t i = 0; i < numDisplays; ++i) {
+        MAX3000_Base & display = *displays[i];
+        if(phases[i] == PHASE_READY) {
+            if(display.pulseDirection) {
+                display.openPulse();
+                phases[i] = PHASE_PULSING;
+                if(!waiter || display.pulseWindow < wait) {
+                    wait   = display.pulseWindow;
+                    waiter = &display;
+                }
+            } else {
+                display.endUpdate();
+                phases[i] = PHASE_DONE;
+            }
+        }
+        windowOpen = windowOpen || phases[i] == PHASE_PULSING;
+        busy       = busy || phases[i] != PHASE_DONE;
+    }
+
+    // Finish shifting a pulse whose window closed, as its next pulse waits
+    // for it. Only the bits that fit before the first open window ends
+    // while other windows are open, so they can be ended on time.
+    for(size_t i = 0; i < numDisplays; ++i) {
+        if(phases[i] == PHASE_LATCHING) {
+            if(windowOpen && displays[i]->shiftPulseBits(waiter->pulseRemainingUs())) {
+                return true;
+            }
+            if(!windowOpen || !displays[i]->isShiftPending()) {
+                displays[i]->latchPulse();
+                phases[i] = PHASE_READY;
+                return true;
+            }
+        }
+    }
+
+    // Shift the next pulse of the window that ends first
+    MAX3000_Base * soonest = NULL;
+    uint32_t soonestUs     = 0;
+    for(size_t i = 0; i < numDisplays; ++i) {
+        if(phases[i] == PHASE_PULSING && displays[i]->isShiftPending()) {
+            uint32_t remaining = displays[i]->pulseRemainingUs();
+            if(!soonest || remaining < soonestUs) {
+                soonest   = displays[i];
+                soonestUs = remaining;
+            }
+        }
+    }
+    if(soonest && soonest->shiftPulseBits(waiter->pulseRemainingUs())) {
+        return true;
+    }
+
+    // Nothing left to shift, wait for the first window to end or update to
+    // start. Long waits go in short chunks, as delayMicroseconds() is
+    // limited on some platforms.
+    if(waiter) {
+        uint32_t remaining = waiter->pulseRemainingUs();
+        waiter->transport->delayUs((frameWaiter && frameWait < remaining) ? frameWait : remaining);
+    } else if(frameWaiter) {
+        frameWaiter->transport->delayUs((frameWait > 1000) ? 1000 : frameWait);
+#if defined(ESP8266)
+        yield();
+#endif
+    }
+    return busy;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file MAX3000_Scheduler.h
+ *
+ * Interleaved updates of several displays driven from one CPU.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * Each pulse of a display holds its enables for the pulse duration, and
+ * display() spends that time shifting the words of the next pulse and then
+ * waiting. Displays on separate pins, such as in the two_boards example,
+ * update one after the other, each waiting out its own pulses.
+ *
+ * MAX3000_Scheduler updates its displays together on the calling thread.
+ * While one display's pulse is running, the others end, start and shift
+ * their own pulses, so the time of an update approaches that of the
+ * slowest display instead of the sum of all of them. Windows are ended as
+ * soon as they are due, but may run over by the time of starting a pulse
+ * or an update on another display.
+ */
+
+#ifndef _MAX3000_Scheduler_H_
+#define _MAX3000_Scheduler_H_
+
+#include <MAX3000_Lib.h>
+
+#define MAX3000_SCHEDULER_MAX_DISPLAYS 4    // Number of displays a scheduler can hold
+
+/**
+ * @brief Updates several MAX3000 displays with their pulses interleaved
+ */
+class MAX3000_Scheduler {
+  public:
+    /**
+     * @brief Constructs a scheduler without any displays.
+     */
+    MAX3000_Scheduler(void);
+
+    /**
+     * @brief Adds a display to update.
+     *
+     * The display must have been started with begin(), and must outlive the
+     * scheduler. Each display needs its own pins or transport.
+     *
+     * @param display Display to add.
+     * @return Returns false if the scheduler is full.
+     */
+    bool add(MAX3000_Base & display);
+
+    /**
+     * @brief Updates all displays with their drawing buffers, and waits until they are done.
+     *
+     * Each display starts its update as with its own displayBegin(), once
+     * its frame period is over. Displays still waiting for theirs don't
+     * hold up the others, which update in the meantime.
+     *
+     * @param force When true, sends a pulse for every pixel, instead of only
+     *              pixels that have changed.
+     */
+    void display(bool force = false);
+
+    /**
+     * @brief Returns the number of displays added.
+     */
+    size_t getDisplayCount(void) const { return numDisplays; }
+
+  protected:
+    /**
+     * @brief Does the most urgent piece of work of any display.
+     *
+     * @return Returns true while any display has pulses left.
+     */
+    bool step(void);
+
+    MAX3000_Base * displays[MAX3000_SCHEDULER_MAX_DISPLAYS];
+    uint8_t phases[MAX3000_SCHEDULER_MAX_DISPLAYS];
+    size_t numDisplays;
+
+    /** @brief Whether the updates of \ref display send a pulse for every pixel */
+    bool forced;
+};
+
+#endif    // _MAX3000_Scheduler_H_
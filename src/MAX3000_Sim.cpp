@@ -0,0 +1,305 @@
+/**
+ * @file MAX3000_Sim.cpp
+ *
+ * Cycle-accurate simulator of a chain of MAX3000 drivers, for use on Linux hosts.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#ifdef WIRINGPI
+#include <MAX3000_Sim.h>
+#include <time.h>
+
+#define SIM_BIT(_w, _p) (((_w) >> (_p)) & 1)
+
+static uint64_t simHostNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+MAX3000_SimTransport::MAX3000_SimTransport(const MAX3000_SimTiming & timing_)
+    : timing(timing_),
+      numBoards(0),
+      chain(NULL),
+      latched(NULL),
+      dots(NULL),
+      panels(NULL),
+      bankThresholdsNs(NULL),
+      pulseEnabled(false),
+      rowEnabled(false),
+      colEnabled(false),
+      windowOpen(false),
+      windowStartNs(0),
+      flipThresholdNs(0),
+      nowNs(0),
+      clockNs(&nowNs),
+      hostStartNs(0),
+      inFrame(false) {
+    resetStats();
+}
+
+MAX3000_SimTransport::~MAX3000_SimTransport(void) {
+    delete[] chain;
+    delete[] latched;
+    delete[] dots;
+    delete[] panels;
+    delete[] bankThresholdsNs;
+}
+
+bool MAX3000_SimTransport::begin(const MAX3000_Config & config, bool periphBegin) {
+    (void)periphBegin;
+
+    delete[] chain;
+    delete[] latched;
+    delete[] dots;
+    delete[] panels;
+    delete[] bankThresholdsNs;
+
+    numBoards        = config.numHBoards * config.numVBoards;
+    chain            = new uint16_t[numBoards];
+    latched          = new uint16_t[numBoards];
+    dots             = new uint8_t[numBoards * PANEL_HEIGHT * PANEL_WIDTH];
+    panels           = new const MAX3000_Panel *[numBoards];
+    bankThresholdsNs = new uint64_t[numBoards * MAX3000_CALIBRATION_BANKS];
+    for(size_t board = 0; board < numBoards; ++board) {
+        panels[board] = (config.panelTypes && config.panelTypes[board]) ? config.panelTypes[board] : &MAX3000_PANEL_28X16;
+    }
+    memset(chain, 0, numBoards * sizeof(uint16_t));
+    memset(latched, 0, numBoards * sizeof(uint16_t));
+    memset(dots, 0, numBoards * PANEL_HEIGHT * PANEL_WIDTH);
+    memset(bankThresholdsNs, 0, numBoards * MAX3000_CALIBRATION_BANKS * sizeof(uint64_t));
+
+    return true;
+}
+
+void MAX3000_SimTransport::setFlipThresholdUs(size_t board, uint8_t colBank, uint8_t rowBank, uint32_t us) {
+    if(board >= numBoards || colBank > 3 || rowBank > 1) {
+        return;
+    }
+    bankThresholdsNs[board * MAX3000_CALIBRATION_BANKS + MAX3000_CALIBRATION_BANK(colBank, rowBank)] = (uint64_t)us * 1000;
+}
+
+void MAX3000_SimTransport::advance(uint64_t ns, uint64_t & counter) {
+    *clockNs += ns;
+    counter += ns;
+    if(inFrame) {
+        frameStats.totalNs += ns;
+    } else {
+        totalStats.totalNs += ns;
+    }
+}
+
+void MAX3000_SimTransport::shiftBits(const uint16_t * words, size_t count, size_t & bitPos, size_t bits) {
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+
+    size_t endPos = bitPos + bits;
+    if(endPos > count * 16) {
+        endPos = count * 16;
+    }
+    if(timing.spiWordNs) {
+        // Hardware SPI sends whole words only
+        endPos = ((endPos + 15) / 16) * 16;
+    }
+
+    // Each clock moves every register one bit further down the chain.
+    size_t sent = 0;
+    for(; bitPos < endPos; ++bitPos, ++sent) {
+        uint16_t bit = (words[bitPos / 16] >> (15 - bitPos % 16)) & 1;
+        for(size_t p = numBoards - 1; p > 0; --p) {
+            chain[p] = (chain[p] << 1) | (chain[p - 1] >> 15);
+        }
+        if(numBoards) {
+            chain[0] = (chain[0] << 1) | bit;
+        }
+    }
+    stats.bitsShifted += sent;
+
+    uint64_t cost;
+    if(timing.spiWordNs) {
+        cost = (uint64_t)(sent / 16) * timing.spiWordNs;
+    } else {
+        cost = (uint64_t)sent * (3 * (uint64_t)timing.gpioWriteNs + 3 * (uint64_t)timing.bitDelayNs);
+    }
+    advance(cost, stats.shiftNs);
+}
+
+void MAX3000_SimTransport::latch(void) {
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+    stats.latches++;
+    if(windowOpen) {
+        stats.faults++;
+    }
+
+    // The first word shifted sits at the far end of the chain, and belongs to board 0.
+    for(size_t board = 0; board < numBoards; ++board) {
+        latched[board] = chain[numBoards - 1 - board];
+    }
+
+    advance(2 * (uint64_t)timing.gpioWriteNs, stats.controlNs);
+}
+
+void MAX3000_SimTransport::setPulseEnable(bool active) {
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+    advance(timing.gpioWriteNs, stats.controlNs);
+    pulseEnabled = active;
+    updateWindow();
+}
+
+void MAX3000_SimTransport::setRowEnable(bool active) {
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+    advance(timing.gpioWriteNs, stats.controlNs);
+    rowEnabled = active;
+    updateWindow();
+}
+
+void MAX3000_SimTransport::setColEnable(bool active) {
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+    advance(timing.gpioWriteNs, stats.controlNs);
+    colEnabled = active;
+    updateWindow();
+}
+
+void MAX3000_SimTransport::reset(void) {
+    memset(chain, 0, numBoards * sizeof(uint16_t));
+    memset(latched, 0, numBoards * sizeof(uint16_t));
+
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+    advance(16000000ULL, stats.delayNs);
+}
+
+void MAX3000_SimTransport::delayUs(uint32_t us) {
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+    if(windowOpen) {
+        advance((uint64_t)us * 1000, stats.pulseNs);
+    } else {
+        advance((uint64_t)us * 1000, stats.delayNs);
+    }
+}
+
+uint32_t MAX3000_SimTransport::getMicros(void) {
+    return (uint32_t)(*clockNs / 1000);
+}
+
+uint32_t MAX3000_SimTransport::estimateShiftNs(size_t bits) {
+    if(timing.spiWordNs) {
+        return (uint32_t)((bits + 15) / 16) * timing.spiWordNs;
+    }
+    return (uint32_t)bits * (3 * timing.gpioWriteNs + 3 * timing.bitDelayNs);
+}
+
+uint32_t MAX3000_SimTransport::estimatePinNs(void) {
+    return timing.gpioWriteNs;
+}
+
+void MAX3000_SimTransport::frameBegin(void) {
+    memset(&frameStats, 0, sizeof(frameStats));
+    frameStats.frames = 1;
+    inFrame           = true;
+    hostStartNs       = simHostNs();
+}
+
+void MAX3000_SimTransport::frameEnd(void) {
+    frameStats.hostNs = simHostNs() - hostStartNs;
+    inFrame           = false;
+
+    totalStats.frames += frameStats.frames;
+    totalStats.bitsShifted += frameStats.bitsShifted;
+    totalStats.latches += frameStats.latches;
+    totalStats.pulses += frameStats.pulses;
+    totalStats.dotPulses += frameStats.dotPulses;
+    totalStats.flips += frameStats.flips;
+    totalStats.weakPulses += frameStats.weakPulses;
+    totalStats.faults += frameStats.faults;
+    if(frameStats.longestPulseNs > totalStats.longestPulseNs) {
+        totalStats.longestPulseNs = frameStats.longestPulseNs;
+    }
+    totalStats.shiftNs += frameStats.shiftNs;
+    totalStats.controlNs += frameStats.controlNs;
+    totalStats.pulseNs += frameStats.pulseNs;
+    totalStats.delayNs += frameStats.delayNs;
+    totalStats.totalNs += frameStats.totalNs;
+    totalStats.hostNs += frameStats.hostNs;
+}
+
+void MAX3000_SimTransport::resetStats(void) {
+    memset(&frameStats, 0, sizeof(frameStats));
+    memset(&totalStats, 0, sizeof(totalStats));
+}
+
+bool MAX3000_SimTransport::getDot(size_t board, uint8_t row, uint8_t col) const {
+    if(board >= numBoards || row >= PANEL_HEIGHT || col >= PANEL_WIDTH) {
+        return false;
+    }
+    return dots[(board * PANEL_WIDTH + col) * PANEL_HEIGHT + row];
+}
+
+void MAX3000_SimTransport::updateWindow(void) {
+    bool open = pulseEnabled && rowEnabled && colEnabled;
+    if(open && !windowOpen) {
+        windowOpen    = true;
+        windowStartNs = *clockNs;
+    } else if(!open && windowOpen) {
+        windowOpen = false;
+        applyWindow(*clockNs - windowStartNs);
+    }
+}
+
+void MAX3000_SimTransport::applyWindow(uint64_t durationNs) {
+    MAX3000_SimStats & stats = inFrame ? frameStats : totalStats;
+    stats.pulses++;
+    if(durationNs > stats.longestPulseNs) {
+        stats.longestPulseNs = durationNs;
+    }
+
+    for(size_t board = 0; board < numBoards; ++board) {
+        uint16_t word   = latched[board];
+        bool rowSource  = SIM_BIT(word, SR_PIN_ROW_SOURCE);
+        bool colSource  = SIM_BIT(word, SR_PIN_COL_SOURCE);
+
+        if(!rowSource && !colSource) {
+            continue;
+        }
+        if(rowSource && colSource) {
+            stats.faults++;
+            continue;
+        }
+
+        uint8_t colCode = (SIM_BIT(word, SR_PIN_COL_A2) << 2) | (SIM_BIT(word, SR_PIN_COL_A1) << 1) | SIM_BIT(word, SR_PIN_COL_A0) |
+                          (SIM_BIT(word, SR_PIN_COL_BANK0) << 3) | (SIM_BIT(word, SR_PIN_COL_BANK1) << 4);
+        uint8_t rowCode = (SIM_BIT(word, SR_PIN_ROW_A2) << 2) | (SIM_BIT(word, SR_PIN_ROW_A1) << 1) | SIM_BIT(word, SR_PIN_ROW_A0) |
+                          (SIM_BIT(word, SR_PIN_ROW_BANK) << 3);
+
+        // Find the dot wired to the codes on the board's panel variant
+        const MAX3000_Panel & panel = *panels[board];
+        int col = -1, row = -1;
+        for(int i = 0; i < panel.width; ++i) {
+            if(panel.colCodes[i] == colCode) {
+                col = (panel.orientation & MAX3000_ORIENT_MIRROR_X) ? (panel.width - 1) - i : i;
+            }
+        }
+        for(int i = 0; i < panel.height; ++i) {
+            if(panel.rowCodes[i] == rowCode) {
+                row = (panel.orientation & MAX3000_ORIENT_MIRROR_Y) ? (panel.height - 1) - i : i;
+            }
+        }
+        if(col < 0 || row < 0) {
+            // Decoder output not connected to a dot
+            continue;
+        }
+
+        stats.dotPulses++;
+        uint64_t bankNs = bankThresholdsNs[board * MAX3000_CALIBRATION_BANKS + MAX3000_CALIBRATION_BANK(colCode >> 3, rowCode >> 3)];
+        if(durationNs < flipThresholdNs || durationNs < bankNs) {
+            stats.weakPulses++;
+            continue;
+        }
+
+        uint8_t & dot = dots[(board * PANEL_WIDTH + col) * PANEL_HEIGHT + row];
+        if(dot != rowSource) {
+            dot = rowSource;
+            stats.flips++;
+        }
+    }
+}
+#endif
@@ -0,0 +1,210 @@
+/**
+ * @file MAX3000_Sim.h
+ *
+ * Cycle-accurate simulator of a chain of MAX3000 drivers, for use on Linux hosts.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * MAX3000_SimTransport replaces the pin transport of a display. Every shifted
+ * word is pushed through a model of the daisy-chained shift registers, and
+ * every PULSE/ROW/COL enable window is decoded into dot flips on a virtual
+ * panel. Time is not spent waiting, but accumulated on a virtual clock using
+ * a configurable cost model, so the wall-clock cost of each display() call
+ * can be reported for chains that don't physically exist.
+ *
+ * Build with -DWIRINGPI -DMAX3000_HOST_SIM to run on a host without wiringPi.
+ */
+
+#ifndef _MAX3000_Sim_H_
+#define _MAX3000_Sim_H_
+
+#include <MAX3000_Lib.h>
+
+/**
+ * @brief Cost model used by the simulator's virtual clock
+ */
+struct MAX3000_SimTiming {
+    /**
+     * @brief Constructs a cost model matching a bit-banged Raspberry Pi.
+     */
+    MAX3000_SimTiming(void)
+        : gpioWriteNs(100),
+          bitDelayNs(8000),
+          spiWordNs(0) {
+    }
+
+    uint32_t gpioWriteNs;    // Cost of a single pin write
+    uint32_t bitDelayNs;     // Bit-bang delay, applied three times per bit (see BITBANG_DELAY)
+    uint32_t spiWordNs;      // If non-zero, models hardware SPI with this cost per 16-bit word
+};
+
+/**
+ * @brief Counters and modeled time accumulated by the simulator
+ */
+struct MAX3000_SimStats {
+    uint32_t frames;          // Number of display() calls
+    uint32_t bitsShifted;     // Number of bits clocked into the chain
+    uint32_t latches;         // Number of latch() calls
+    uint32_t pulses;          // Number of PULSE/ROW/COL enable windows
+    uint32_t dotPulses;       // Number of dots driven by a pulse window
+    uint32_t flips;           // Number of dots that changed state
+    uint32_t weakPulses;      // Dots driven by a window shorter than the flip threshold
+    uint32_t faults;          // Row and column both sourced, or latched during a window
+    uint64_t longestPulseNs;  // Longest pulse window
+    uint64_t shiftNs;         // Modeled time spent shifting
+    uint64_t controlNs;       // Modeled time spent on latch and enable pin writes
+    uint64_t pulseNs;         // Modeled time waited while a pulse window was open
+    uint64_t delayNs;         // Modeled time waited outside of pulse windows
+    uint64_t totalNs;         // Total modeled time
+    uint64_t hostNs;          // Host CPU time spent between frameBegin() and frameEnd()
+};
+
+/**
+ * @brief Transport emulating a chain of MAX3000 drivers and their panels
+ */
+class MAX3000_SimTransport : public MAX3000_Transport {
+  public:
+    /**
+     * @brief Constructs a new simulator.
+     * @param timing Cost model for the virtual clock.
+     */
+    MAX3000_SimTransport(const MAX3000_SimTiming & timing = MAX3000_SimTiming());
+
+    /**
+     * @brief Virtual Destuctor
+     */
+    virtual ~MAX3000_SimTransport(void);
+
+    virtual bool begin(const MAX3000_Config & config, bool periphBegin);
+    virtual void shiftBits(const uint16_t * words, size_t numBoards, size_t & bitPos, size_t count);
+    virtual void latch(void);
+    virtual void setPulseEnable(bool active);
+    virtual void setRowEnable(bool active);
+    virtual void setColEnable(bool active);
+    virtual void reset(void);
+    virtual void delayUs(uint32_t us);
+    virtual uint32_t getMicros(void);
+    virtual uint32_t estimateShiftNs(size_t bits);
+    virtual uint32_t estimatePinNs(void);
+    virtual void frameBegin(void);
+    virtual void frameEnd(void);
+
+    /**
+     * @brief Returns the simulated state of a single dot.
+     *
+     * @param board Board Index, starting from 0, in the order words are passed to shift().
+     * @param row Row index within a single panel, 0 at top.
+     * @param col Column index within a single panel, 0 at left.
+     * @return true if the dot is set.
+     */
+    bool getDot(size_t board, uint8_t row, uint8_t col) const;
+
+    /**
+     * @brief Returns the number of boards in the simulated chain.
+     */
+    size_t getNumBoards(void) const { return numBoards; }
+
+    /**
+     * @brief Sets the minimum pulse window needed for a dot to flip.
+     *
+     * Dots driven by a shorter window keep their state and are counted as weak pulses.
+     *
+     * @param us Threshold in microseconds, 0 to flip on any window.
+     */
+    void setFlipThresholdUs(uint32_t us) { flipThresholdNs = (uint64_t)us * 1000; }
+
+    /**
+     * @brief Sets the minimum pulse window needed for the dots of one decoder bank of a board to flip.
+     *
+     * Models dots of varying stickiness, as calibrated with MAX3000_Calibration.
+     * The larger of this and the threshold of the whole chain applies. Call
+     * after begin(), which clears the thresholds of every bank.
+     *
+     * @param board Board Index, starting from 0
+     * @param colBank Column bank, 0 to 3, the upper two bits of the column code.
+     * @param rowBank Row bank, 0 or 1, the upper bit of the row code.
+     * @param us Threshold in microseconds.
+     */
+    void setFlipThresholdUs(size_t board, uint8_t colBank, uint8_t rowBank, uint32_t us);
+
+    /**
+     * @brief Returns the statistics of the most recent display() call.
+     */
+    const MAX3000_SimStats & getFrameStats(void) const { return frameStats; }
+
+    /**
+     * @brief Returns the statistics accumulated since the last resetStats().
+     */
+    const MAX3000_SimStats & getTotalStats(void) const { return totalStats; }
+
+    /**
+     * @brief Clears accumulated statistics.
+     */
+    void resetStats(void);
+
+    /**
+     * @brief Returns the current time of the virtual clock in nanoseconds.
+     */
+    uint64_t getNowNs(void) const { return *clockNs; }
+
+    /**
+     * @brief Makes this simulator use the virtual clock of another one.
+     *
+     * Models several chains driven from one CPU, such as displays on
+     * separate pins updated by MAX3000_Scheduler, where time spent on one
+     * chain passes for all of them. Statistics stay separate.
+     *
+     * @param other Simulator whose clock to use. Must outlive this one.
+     */
+    void shareClock(MAX3000_SimTransport & other) { clockNs = other.clockNs; }
+
+  protected:
+    /**
+     * @brief Advances the virtual clock, accounting the time to the given counter.
+     */
+    void advance(uint64_t ns, uint64_t & counter);
+
+    /**
+     * @brief Updates the pulse window state after an enable pin changed.
+     */
+    void updateWindow(void);
+
+    /**
+     * @brief Applies the latched words of every board to the dots.
+     */
+    void applyWindow(uint64_t durationNs);
+
+    MAX3000_SimTiming timing;
+
+    size_t numBoards;
+
+    /** @brief Words held in each shift register, indexed from the chain input */
+    uint16_t * chain;
+
+    /** @brief Words on each driver's outputs, indexed by board */
+    uint16_t * latched;
+
+    /** @brief Dot state, one byte per dot, PANEL_HEIGHT * PANEL_WIDTH per board */
+    uint8_t * dots;
+
+    /** @brief Panel variant of each board, decoding its row and column codes */
+    const MAX3000_Panel ** panels;
+
+    /** @brief Flip threshold of each decoder bank, MAX3000_CALIBRATION_BANKS per board */
+    uint64_t * bankThresholdsNs;
+
+    bool pulseEnabled, rowEnabled, colEnabled;
+    bool windowOpen;
+    uint64_t windowStartNs;
+    uint64_t flipThresholdNs;
+
+    uint64_t nowNs;
+    uint64_t * clockNs;    // Virtual clock in use, nowNs unless shared
+    uint64_t hostStartNs;
+    bool inFrame;
+
+    MAX3000_SimStats frameStats;
+    MAX3000_SimStats totalStats;
+};
+
+#endif    // _MAX3000_Sim_H_
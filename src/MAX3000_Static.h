@@ -0,0 +1,341 @@
+/**
+ * @file MAX3000_Static.h
+ *
+ * Display with its size fixed at compile time, and all memory in the object.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * MAX3000_Display allocates its buffers and per-board tables in begin(), so
+ * their size is only known at runtime, and on small microcontrollers they
+ * share the heap with everything else. MAX3000_Static holds the same memory
+ * as arrays sized by its template parameters, and begin() uses them in place
+ * of allocating. A display declared as a global shows up in the RAM usage
+ * reported by the linker, and never touches the heap.
+ *
+ * The width, height, board counts and strides are compile-time constants.
+ * drawPixel() and getPixel() are specialized with them, so the buffer
+ * layout and board order cost no lookups or branches while drawing. The
+ * update loops of MAX3000_Update.h are compiled with them too, so comparing
+ * frames and picking pixels loop over a constant number of boards at
+ * constant offsets.
+ *
+ * The per-board state of calibrated pulses is only held with the Calibrated
+ * parameter set, otherwise setCalibration() fails.
+ */
+
+#ifndef _MAX3000_Static_H_
+#define _MAX3000_Static_H_
+
+#include <MAX3000_Lib.h>
+#include <MAX3000_Update.h>
+
+/**
+ * @brief MAX3000 display sized at compile time, without heap allocations
+ *
+ * @tparam Width Total width of the display in pixels, rounded up to whole panels.
+ * @tparam Height Total height of the display in pixels, rounded up to whole panels.
+ * @tparam Order Ordering of boards within the data chain, one of MAX3000_ORDER_*.
+ * @tparam Layout Arrangement of pixels in the frame buffer, one of MAX3000_LAYOUT_*.
+ * @tparam Mode One of MAX3000_BUFFER_*. Double buffering holds a third frame buffer.
+ * @tparam Calibrated Whether setCalibration() can be used, which holds 6 more bytes per board.
+ */
+template <uint16_t Width, uint16_t Height, uint8_t Order = MAX3000_ORDER_ROW_MAJOR,
+    uint8_t Layout = MAX3000_LAYOUT_PAGED, uint8_t Mode = MAX3000_BUFFER_SINGLE, bool Calibrated = false>
+class MAX3000_Static : public MAX3000_Display {
+  public:
+    // Geometry of the display, in pixels and in panels
+    static constexpr uint16_t WIDTH      = ((Width + (PANEL_WIDTH - 1)) / PANEL_WIDTH) * PANEL_WIDTH;
+    static constexpr uint16_t HEIGHT     = ((Height + (PANEL_HEIGHT - 1)) / PANEL_HEIGHT) * PANEL_HEIGHT;
+    static constexpr size_t NUM_H_BOARDS = WIDTH / PANEL_WIDTH;
+    static constexpr size_t NUM_V_BOARDS = HEIGHT / PANEL_HEIGHT;
+    static constexpr size_t NUM_BOARDS   = NUM_H_BOARDS * NUM_V_BOARDS;
+
+    // Size of each frame buffer in bytes
+    static constexpr size_t BUFFER_BYTES = WIDTH * (HEIGHT / 8);
+
+    // Number of set and clear cursors walking duration classes
+    static constexpr size_t CLASS_SLOTS = Calibrated ? NUM_BOARDS * 2 : 1;
+
+    static_assert(Width > 0 && Height > 0, "A display needs at least one panel");
+
+    /**
+     * @brief Constructs a display driving software SPI pins.
+     *
+     * @param mosi_pin Pin number connected to the MTX_DIN data pin on the driver.
+     * @param sclk_pin Pin number connected to the MTX_CLK clock pin on the driver.
+     * @param lat_pin Pin number connected to the MTX_LAT latch pin on the driver.
+     * @param rst_pin Pin number connected to the MTX_RST reset pin on the driver.
+     * @param pulse_pin Pin number connected to the PULSE_ENABLE pin on the driver.
+     * @param col_pin Pin number connected to the COL_ENABLE_N pin on the driver.
+     * @param row_pin Pin number connected to the ROW_ENABLE_N pin on the driver.
+     * @param boardOrientations Orientation of each board, see MAX3000_Config::boardOrientations.
+     * @param panelTypes Panel variant of each board, see MAX3000_Config::panelTypes.
+     */
+    MAX3000_Static(int8_t mosi_pin, int8_t sclk_pin, int8_t lat_pin, int8_t rst_pin, int8_t pulse_pin,
+        int8_t col_pin, int8_t row_pin, const uint8_t * boardOrientations = NULL,
+        const MAX3000_Panel * const * panelTypes = NULL)
+        : MAX3000_Display(configure(MAX3000_Config(WIDTH, HEIGHT, mosi_pin, sclk_pin, lat_pin, rst_pin,
+                                        pulse_pin, col_pin, row_pin),
+              NULL, boardOrientations, panelTypes)) {
+        useStorage();
+    }
+
+    /**
+     * @brief Constructs a display driving a transport, see MAX3000_Transport.h.
+     *
+     * @param transport Transport to use. Must outlive the display object.
+     * @param boardOrientations Orientation of each board, see MAX3000_Config::boardOrientations.
+     * @param panelTypes Panel variant of each board, see MAX3000_Config::panelTypes.
+     */
+    MAX3000_Static(MAX3000_Transport & transport, const uint8_t * boardOrientations = NULL,
+        const MAX3000_Panel * const * panelTypes = NULL)
+        : MAX3000_Display(configure(MAX3000_Config(WIDTH, HEIGHT, -1, -1, -1, -1, -1, -1, -1), &transport,
+              boardOrientations, panelTypes)) {
+        useStorage();
+    }
+
+    /**
+     * @brief Destructor, detaches the storage so the base class doesn't free it.
+     */
+    virtual ~MAX3000_Static(void) {
+        buffer           = NULL;
+        oldBuffer        = NULL;
+        frontBuffer      = NULL;
+        shiftReg         = NULL;
+        setCursor        = NULL;
+        clearCursor      = NULL;
+        pending          = NULL;
+        pendingSet       = NULL;
+        pendingClear     = NULL;
+        scanNext         = NULL;
+        dirtyFirst       = NULL;
+        dirtyLast        = NULL;
+        boardOffsets     = NULL;
+        boardPanels      = NULL;
+        panelBoards      = NULL;
+        boardOrientation = NULL;
+        boardTypes       = NULL;
+        cursorClass      = NULL;
+        classPassed      = NULL;
+    }
+
+    /**
+     * @brief Set/clear/invert a single pixel, see MAX3000_Base::drawPixel().
+     */
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) {
+        if(!rotate(x, y)) {
+            return;
+        }
+
+        // Single pixels only widen the dirty range of their own board
+        uint8_t col  = x % PANEL_WIDTH;
+        size_t board = boardAt(x / PANEL_WIDTH, y / PANEL_HEIGHT);
+        if(col < dirtyFirst[board]) {
+            dirtyFirst[board] = col;
+        }
+        if(col > dirtyLast[board]) {
+            dirtyLast[board] = col;
+        }
+
+        uint8_t & pixels = buffer[offsetOf(x, y)];
+        switch(color) {
+            case MAX3000_LIGHT:
+                pixels |= (1 << (y & 7));
+                break;
+            case MAX3000_DARK:
+                pixels &= ~(1 << (y & 7));
+                break;
+            case MAX3000_INVERSE:
+                pixels ^= (1 << (y & 7));
+                break;
+        }
+    }
+
+    /**
+     * @brief Return color of a single pixel, see MAX3000_Base::getPixel().
+     */
+    bool getPixel(int16_t x, int16_t y) {
+        if(!rotate(x, y)) {
+            return false;
+        }
+        return (buffer[offsetOf(x, y)] & (1 << (y & 7))) != 0;
+    }
+
+    /**
+     * @brief Sets a map of pulse durations, see MAX3000_Base::setCalibration().
+     *
+     * @return Also returns false when setting a map without the Calibrated parameter.
+     */
+    virtual bool setCalibration(const MAX3000_Calibration * calibration) {
+        return (Calibrated || !calibration) && MAX3000_Display::setCalibration(calibration);
+    }
+
+  protected:
+    /**
+     * @brief Geometry of the display at compile time, see MAX3000_Update.h
+     */
+    struct StaticGeometry {
+        // Whether the loops handle a calibration
+        static const bool CALIBRATED = Calibrated;
+
+        static constexpr size_t numBoards(const MAX3000_Base &) { return NUM_BOARDS; }
+        static constexpr size_t pageStride(const MAX3000_Base &) { return (Layout == MAX3000_LAYOUT_PANEL) ? PANEL_WIDTH : WIDTH; }
+        static constexpr size_t boardOffset(const MAX3000_Base &, size_t board) {
+            return (Layout == MAX3000_LAYOUT_PANEL) ? board * PANEL_PENDING_BYTES
+                                                    : panelXOf(board) * PANEL_WIDTH + panelYOf(board) * (PANEL_HEIGHT / 8) * WIDTH;
+        }
+        static constexpr size_t originX(const MAX3000_Base &, size_t board) { return panelXOf(board) * PANEL_WIDTH; }
+        static constexpr size_t originY(const MAX3000_Base &, size_t board) { return panelYOf(board) * PANEL_HEIGHT; }
+        static constexpr uint16_t width(const MAX3000_Base &) { return WIDTH; }
+        static constexpr uint16_t height(const MAX3000_Base &) { return HEIGHT; }
+    };
+
+    /**
+     * @brief Compares the frame with the constant geometry, see MAX3000_Base::diffBuffers().
+     */
+    virtual void diffBuffers(bool force, bool tracked, bool retarget) {
+        diffBoards<StaticGeometry>(force, tracked, retarget);
+    }
+
+    /**
+     * @brief Loads the next pulse with the constant geometry, see MAX3000_Base::loadStepPulse().
+     */
+    virtual uint8_t loadStepPulse(void) {
+        return loadBoards<StaticGeometry>();
+    }
+
+    /**
+     * @brief Completes a configuration with the template parameters.
+     */
+    static MAX3000_Config configure(MAX3000_Config config, MAX3000_Transport * transport, const uint8_t * boardOrientations,
+        const MAX3000_Panel * const * panelTypes) {
+        config.boardOrder        = Order;
+        config.bufferLayout      = Layout;
+        config.bufferMode        = Mode;
+        config.boardOrientations = boardOrientations;
+        config.panelTypes        = panelTypes;
+        config.transport         = transport;
+        return config;
+    }
+
+    /**
+     * @brief Points the base class at the arrays of this object, so begin() doesn't allocate.
+     */
+    void useStorage(void) {
+        buffer           = staticBuffer;
+        oldBuffer        = staticOldBuffer;
+        frontBuffer      = (Mode == MAX3000_BUFFER_DOUBLE) ? staticFrontBuffer : NULL;
+        shiftReg         = staticShiftReg;
+        setCursor        = staticSetCursor;
+        clearCursor      = staticClearCursor;
+        pending          = staticPending;
+        pendingSet       = staticPendingSet;
+        pendingClear     = staticPendingClear;
+        scanNext         = staticScanNext;
+        dirtyFirst       = staticDirtyFirst;
+        dirtyLast        = staticDirtyLast;
+        boardOffsets     = staticBoardOffsets;
+        boardPanels      = staticBoardPanels;
+        panelBoards      = staticPanelBoards;
+        boardOrientation = staticBoardOrientation;
+        boardTypes       = staticBoardTypes;
+        cursorClass      = Calibrated ? staticCursorClass : NULL;
+        classPassed      = Calibrated ? staticClassPassed : NULL;
+    }
+
+    /**
+     * @brief Checks a pixel is on the display, and rotates it into the frame buffer.
+     *
+     * @return Returns false if the pixel is out of bounds.
+     */
+    bool rotate(int16_t & x, int16_t & y) const {
+        if((x < 0) || (x >= localWidth) || (y < 0) || (y >= localHeight)) {
+            return false;
+        }
+        int16_t t;
+        switch(localRotation) {
+            case 1:
+                t = x;
+                x = WIDTH - y - 1;
+                y = t;
+                break;
+            case 2:
+                x = WIDTH - x - 1;
+                y = HEIGHT - y - 1;
+                break;
+            case 3:
+                t = y;
+                y = HEIGHT - x - 1;
+                x = t;
+                break;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns the board driving a panel position, as mapped by the board order.
+     */
+    static constexpr size_t boardAt(size_t panelX, size_t panelY) {
+        return (Order == MAX3000_ORDER_ROW_MAJOR_BOUNCE)
+                   ? panelY * NUM_H_BOARDS + ((panelY & 1) ? (NUM_H_BOARDS - 1 - panelX) : panelX)
+               : (Order == MAX3000_ORDER_COL_MAJOR)
+                   ? panelX * NUM_V_BOARDS + panelY
+               : (Order == MAX3000_ORDER_COL_MAJOR_BOUNCE)
+                   ? panelX * NUM_V_BOARDS + ((panelX & 1) ? (NUM_V_BOARDS - 1 - panelY) : panelY)
+                   : panelY * NUM_H_BOARDS + panelX;
+    }
+
+    /**
+     * @brief Returns the column of panels driven by a board, as mapped by the board order.
+     */
+    static constexpr size_t panelXOf(size_t board) {
+        return (Order == MAX3000_ORDER_COL_MAJOR || Order == MAX3000_ORDER_COL_MAJOR_BOUNCE)
+                   ? board / NUM_V_BOARDS
+               : (Order == MAX3000_ORDER_ROW_MAJOR_BOUNCE && ((board / NUM_H_BOARDS) & 1))
+                   ? NUM_H_BOARDS - 1 - board % NUM_H_BOARDS
+                   : board % NUM_H_BOARDS;
+    }
+
+    /**
+     * @brief Returns the row of panels driven by a board, as mapped by the board order.
+     */
+    static constexpr size_t panelYOf(size_t board) {
+        return (Order == MAX3000_ORDER_ROW_MAJOR || Order == MAX3000_ORDER_ROW_MAJOR_BOUNCE)
+                   ? board / NUM_H_BOARDS
+               : (Order == MAX3000_ORDER_COL_MAJOR_BOUNCE && ((board / NUM_V_BOARDS) & 1))
+                   ? NUM_V_BOARDS - 1 - board % NUM_V_BOARDS
+                   : board % NUM_V_BOARDS;
+    }
+
+    /**
+     * @brief Returns the offset in the frame buffer of the byte holding a pixel.
+     */
+    static constexpr size_t offsetOf(size_t x, size_t y) {
+        return (Layout == MAX3000_LAYOUT_PANEL)
+                   ? boardAt(x / PANEL_WIDTH, y / PANEL_HEIGHT) * PANEL_PENDING_BYTES +
+                         ((y % PANEL_HEIGHT) / 8) * PANEL_WIDTH + (x % PANEL_WIDTH)
+                   : x + (y / 8) * WIDTH;
+    }
+
+    uint8_t staticBuffer[BUFFER_BYTES];
+    uint8_t staticOldBuffer[BUFFER_BYTES];
+    uint8_t staticFrontBuffer[(Mode == MAX3000_BUFFER_DOUBLE) ? BUFFER_BYTES : 1];
+    uint16_t staticShiftReg[NUM_BOARDS];
+    uint16_t staticSetCursor[NUM_BOARDS];
+    uint16_t staticClearCursor[NUM_BOARDS];
+    uint8_t staticPending[NUM_BOARDS * PANEL_PENDING_BYTES];
+    uint16_t staticPendingSet[NUM_BOARDS];
+    uint16_t staticPendingClear[NUM_BOARDS];
+    uint16_t staticScanNext[NUM_BOARDS];
+    uint8_t staticDirtyFirst[NUM_BOARDS];
+    uint8_t staticDirtyLast[NUM_BOARDS];
+    size_t staticBoardOffsets[NUM_BOARDS];
+    uint16_t staticBoardPanels[NUM_BOARDS];
+    uint16_t staticPanelBoards[NUM_BOARDS];
+    uint8_t staticBoardOrientation[NUM_BOARDS];
+    const MAX3000_Panel * staticBoardTypes[NUM_BOARDS];
+    uint8_t staticCursorClass[CLASS_SLOTS];
+    uint16_t staticClassPassed[CLASS_SLOTS];
+};
+
+#endif    // _MAX3000_Static_H_
@@ -0,0 +1,283 @@
+/**
+ * @file MAX3000_Stream.cpp
+ *
+ * Display rendered one panel at a time, for walls larger than RAM.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#include <MAX3000_Stream.h>
+
+// Pulse directions, as used by MAX3000_Base
+#define PULSE_SET 0x1
+#define PULSE_CLEAR 0x2
+
+#define SOURCE_MASK ((1 << SR_PIN_COL_SOURCE) | (1 << SR_PIN_ROW_SOURCE))
+
+MAX3000_Stream::MAX3000_Stream(const MAX3000_Config & config, MAX3000_TileRenderer renderer_, void * context_,
+    uint8_t store_, uint8_t tilesAtOnce_)
+    : MAX3000_Base(config),
+      renderer(renderer_),
+      context(context_),
+      store(store_),
+      tilesAtOnce(tilesAtOnce_ ? tilesAtOnce_ : 1),
+      states(NULL),
+      hashes(NULL),
+      tiles(NULL),
+      tileCursors(NULL),
+      tileForced(NULL),
+      groupFirst(0),
+      groupCount(0),
+      skippedPanels(0) {
+}
+
+MAX3000_Stream::~MAX3000_Stream(void) {
+    delete[] states;
+    delete[] hashes;
+    delete[] tiles;
+    delete[] tileCursors;
+    delete[] tileForced;
+}
+
+bool MAX3000_Stream::begin(bool reset, bool periphBegin) {
+    size_t numBoards = config.numVBoards * config.numHBoards;
+    if(tilesAtOnce > numBoards) {
+        tilesAtOnce = numBoards;
+    }
+
+    // Create the record kept of each panel between updates
+    if(store == MAX3000_STREAM_HASH) {
+        if((!hashes) && !(hashes = new uint32_t[numBoards])) {
+            return false;
+        }
+        memset(hashes, 0, numBoards * sizeof(uint32_t));
+    } else {
+        if((!states) && !(states = new uint8_t[numBoards * PANEL_PENDING_BYTES])) {
+            return false;
+        }
+        memset(states, 0, numBoards * PANEL_PENDING_BYTES);
+    }
+
+    // Create the tiles of one group
+    if((!tiles) && !(tiles = new uint8_t[tilesAtOnce * PANEL_PENDING_BYTES])) {
+        return false;
+    }
+    if((!tileCursors) && !(tileCursors = new uint16_t[tilesAtOnce * 2])) {
+        return false;
+    }
+    if((!tileForced) && !(tileForced = new bool[tilesAtOnce])) {
+        return false;
+    }
+    memset(tiles, 0, tilesAtOnce * PANEL_PENDING_BYTES);
+
+    // Create the tables mapping boards to their panels, as in MAX3000_Base::begin()
+    if((!boardOffsets) && !(boardOffsets = new size_t[numBoards])) {
+        return false;
+    }
+    if((!boardPanels) && !(boardPanels = new uint16_t[numBoards])) {
+        return false;
+    }
+    if((!panelBoards) && !(panelBoards = new uint16_t[numBoards])) {
+        return false;
+    }
+    if((!boardOrientation) && !(boardOrientation = new uint8_t[numBoards])) {
+        return false;
+    }
+    if((!boardTypes) && !(boardTypes = new const MAX3000_Panel *[numBoards])) {
+        return false;
+    }
+    mapBoards();
+
+    // Create buffer for output to each shift register
+    if((!shiftReg) && !(shiftReg = new uint16_t[numBoards])) {
+        return false;
+    }
+    memset(shiftReg, 0, numBoards * sizeof(uint16_t));
+
+    // Set up hardware pins and SPI
+    if(!transport->begin(config, periphBegin)) {
+        return false;
+    }
+
+    // Set initial non-pulse state
+    transport->setPulseEnable(false);
+    transport->setRowEnable(false);
+    transport->setColEnable(false);
+
+    // Reset MAX3000 if requested
+    if(reset) {
+        transport->reset();
+    }
+
+    firstUpdate = true;
+    return true;
+}
+
+void MAX3000_Stream::display(bool force) {
+    size_t numBoards = config.numVBoards * config.numHBoards;
+    if(!tiles) {
+        return;
+    }
+
+    waitForFrame();
+    transport->frameBegin();
+    updateActive  = true;
+    skippedPanels = 0;
+
+    for(size_t first = 0; first < numBoards; first += tilesAtOnce) {
+        updateGroup(first, (numBoards - first < tilesAtOnce) ? (numBoards - first) : tilesAtOnce, force);
+#if defined(ESP8266)
+        yield();
+#endif
+    }
+
+    updateActive = false;
+    firstUpdate  = false;
+    transport->frameEnd();
+}
+
+void MAX3000_Stream::invertDisplay(bool i) {
+    invertEnabled = i;
+
+    // The tiles didn't change, so every pixel has to be sent again.
+    display(true);
+}
+
+void MAX3000_Stream::updateGroup(size_t first, size_t count, bool force) {
+    groupFirst = first;
+    groupCount = count;
+
+    bool changed = false;
+    for(size_t slot = 0; slot < count; ++slot) {
+        size_t board            = first + slot;
+        uint8_t * tile          = &tiles[slot * PANEL_PENDING_BYTES];
+        const uint8_t * present = boardTypes[board]->present;
+        renderer(boardPanels[board] % config.numHBoards, boardPanels[board] / config.numHBoards, tile, context);
+
+        tileCursors[slot * 2]     = 0;
+        tileCursors[slot * 2 + 1] = 0;
+        tileForced[slot]          = force || firstUpdate;
+
+        // Hashes can only tell whether the panel changed, so all of a changed
+        // panel's pixels are pulsed. The state store is compared pixel by pixel.
+        bool boardChanged = tileForced[slot];
+        if(store == MAX3000_STREAM_HASH) {
+            uint32_t hash    = MAX3000_Plan::hash(tile, PANEL_PENDING_BYTES);
+            boardChanged     = boardChanged || (hash != hashes[board]);
+            tileForced[slot] = boardChanged;
+            hashes[board]    = hash;
+        } else {
+            const uint8_t * state = &states[board * PANEL_PENDING_BYTES];
+            for(size_t i = 0; i < PANEL_PENDING_BYTES && !boardChanged; ++i) {
+                boardChanged = ((tile[i] ^ state[i]) & pgm_read_byte(&present[i])) != 0;
+            }
+        }
+
+        if(boardChanged) {
+            changed = true;
+        } else {
+            skippedPanels++;
+            tileCursors[slot * 2]     = PANEL_HEIGHT * PANEL_WIDTH;
+            tileCursors[slot * 2 + 1] = PANEL_HEIGHT * PANEL_WIDTH;
+        }
+    }
+    if(!changed) {
+        return;
+    }
+
+    // Send the group's pulses through the pipeline of MAX3000_Base::sendPulse(),
+    // which calls loadNextPulse() for the words of each next pulse.
+    pendingDirections = PULSE_SET | PULSE_CLEAR;
+    nextDirection     = PULSE_SET;
+    pulseDirection    = loadNextPulse();
+    pulseWindow       = pulseDuration;
+    if(pulseDirection) {
+        transport->shift(shiftReg, config.numHBoards * config.numVBoards);
+        transport->latch();
+    }
+    while(pulseDirection) {
+        sendPulse();
+    }
+}
+
+uint8_t MAX3000_Stream::loadNextPulse(void) {
+    if(pulseMode == MAX3000_PULSE_COMBINED) {
+        // Set or clear the next changed pixel on each board, all in one pulse.
+        bool found = false;
+        for(size_t slot = 0; slot < groupCount; ++slot) {
+            size_t board      = groupFirst + slot;
+            uint8_t direction = nextTilePixel(slot, PULSE_SET | PULSE_CLEAR);
+            shiftReg[board]   = (shiftReg[board] & ~SOURCE_MASK) | ((direction == PULSE_CLEAR) << SR_PIN_COL_SOURCE) | ((direction == PULSE_SET) << SR_PIN_ROW_SOURCE);
+            found             = found || direction;
+        }
+        return found ? (PULSE_SET | PULSE_CLEAR) : 0;
+    }
+
+    // Alternate between pulses setting and clearing pixels, until neither
+    // direction has any pixels left on any board of the group.
+    for(uint8_t attempt = 0; attempt < 2; ++attempt) {
+        uint8_t direction = nextDirection;
+        nextDirection ^= (PULSE_SET | PULSE_CLEAR);
+        if(!(pendingDirections & direction)) {
+            continue;
+        }
+
+        bool found = false;
+        for(size_t slot = 0; slot < groupCount; ++slot) {
+            // Setting -> Row Set Source, Column sink
+            // Clearing -> Column Source, Row sink
+            size_t board    = groupFirst + slot;
+            bool boardFound = nextTilePixel(slot, direction);
+            shiftReg[board] = (shiftReg[board] & ~SOURCE_MASK) | ((boardFound && direction == PULSE_CLEAR) << SR_PIN_COL_SOURCE) | ((boardFound && direction == PULSE_SET) << SR_PIN_ROW_SOURCE);
+            found           = found || boardFound;
+        }
+        if(found) {
+            return direction;
+        }
+        pendingDirections &= ~direction;
+    }
+
+    return 0;
+}
+
+uint8_t MAX3000_Stream::nextTilePixel(size_t slot, uint8_t directions) {
+    size_t board            = groupFirst + slot;
+    const uint8_t * tile    = &tiles[slot * PANEL_PENDING_BYTES];
+    uint8_t * state         = states ? &states[board * PANEL_PENDING_BYTES] : NULL;
+    const uint8_t * present = boardTypes[board]->present;
+    uint16_t & cursor       = tileCursors[slot * 2 + (directions == PULSE_CLEAR)];
+
+    while(cursor < PANEL_HEIGHT * PANEL_WIDTH) {
+        size_t col = cursor / PANEL_HEIGHT;
+        size_t row = cursor % PANEL_HEIGHT;
+
+        // Skip over columns without changes
+        if(row == 0 && !tileForced[slot] && tile[col] == state[col] && tile[col + PANEL_WIDTH] == state[col + PANEL_WIDTH]) {
+            cursor += PANEL_HEIGHT;
+            continue;
+        }
+        cursor++;
+
+        size_t offset = col + (row / 8) * PANEL_WIDTH;
+        uint8_t bit   = 1 << (row & 7);
+        uint8_t mask  = tileForced[slot] ? 0xFF : (tile[offset] ^ state[offset]);
+        if(!(mask & bit & pgm_read_byte(&present[offset]))) {
+            continue;
+        }
+
+        // Only pick pixels being driven in the requested direction
+        bool newPixVal    = tile[offset] & bit;
+        uint8_t direction = (newPixVal != invertEnabled) ? PULSE_SET : PULSE_CLEAR;
+        if(!(direction & directions)) {
+            continue;
+        }
+
+        if(state) {
+            state[offset] = (state[offset] & ~bit) | (tile[offset] & bit);
+        }
+        selectRowColumn(board, row, col);
+        return direction;
+    }
+
+    return 0;
+}
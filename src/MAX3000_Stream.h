@@ -0,0 +1,174 @@
+/**
+ * @file MAX3000_Stream.h
+ *
+ * Display rendered one panel at a time, for walls larger than RAM.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * MAX3000_Display keeps the drawn frame, the physical state of the dots and
+ * the pending changes for every panel, 168 bytes each, which limits the size
+ * of a wall on an ATmega328P to a handful of panels. MAX3000_Stream keeps no
+ * frame buffer at all. Each update asks the application to render the
+ * panels a few at a time into a small tile buffer, and compares each tile
+ * against a compact record of the panel:
+ *
+ * - MAX3000_STREAM_STATE keeps the physical state of each panel, 56 bytes,
+ *   and pulses only the pixels that changed, as MAX3000_Display does.
+ * - MAX3000_STREAM_HASH keeps a 4 byte hash of each panel's last tile. Panels
+ *   whose tile didn't change are skipped, and changed panels have every one
+ *   of their pixels pulsed, as the state of their dots isn't known.
+ *
+ * Suited to generated content such as clocks, counters and tickers, where a
+ * panel can be rendered from a few variables.
+ */
+
+#ifndef _MAX3000_Stream_H_
+#define _MAX3000_Stream_H_
+
+#include <MAX3000_Lib.h>
+
+#define MAX3000_STREAM_STATE 0    // Keep the physical state of each panel, pulse only changed pixels
+#define MAX3000_STREAM_HASH 1     // Keep a hash of each panel, pulse every pixel of changed panels
+
+/**
+ * @brief Renders the tile of one panel.
+ *
+ * The tile has the layout of a panel in MAX3000_LAYOUT_PANEL: byte
+ * (col + (row / 8) * PANEL_WIDTH) holds rows row & ~7 to (row | 7) of a
+ * column, with the top row in the lowest bit. It holds the previous tile
+ * rendered into the same slot, so renderers should write every byte.
+ *
+ * @param panelX Column of the panel on the display, counted in panels from the left.
+ * @param panelY Row of the panel on the display, counted in panels from the top.
+ * @param tile PANEL_PENDING_BYTES bytes to render the panel into.
+ * @param context Pointer given to the display's constructor.
+ */
+typedef void (*MAX3000_TileRenderer)(uint16_t panelX, uint16_t panelY, uint8_t * tile, void * context);
+
+/**
+ * @brief MAX3000 display whose frames are rendered panel by panel on demand
+ */
+class MAX3000_Stream : protected MAX3000_Base {
+  public:
+    /**
+     * @brief Constructs a new MAX3000_Stream object.
+     *
+     * The buffer layout and mode of the configuration are ignored. Call the
+     * object's begin() function before use.
+     *
+     * @param config \ref MAX3000_Config object containing parameters for display
+     * @param renderer Function rendering each panel's tile.
+     * @param context Pointer passed to the renderer.
+     * @param store What to keep of each panel between updates, MAX3000_STREAM_STATE or MAX3000_STREAM_HASH.
+     * @param tilesAtOnce Number of panels rendered and flipped together. Each
+     *                    costs PANEL_PENDING_BYTES of RAM, and panels flipped
+     *                    together share their pulses.
+     */
+    MAX3000_Stream(const MAX3000_Config & config, MAX3000_TileRenderer renderer, void * context = NULL,
+        uint8_t store = MAX3000_STREAM_STATE, uint8_t tilesAtOnce = 1);
+
+    /**
+     * @brief Destructor, frees the panel records and tiles.
+     */
+    virtual ~MAX3000_Stream(void);
+
+    /**
+     * @brief Allocate RAM for the panel records and tiles, and initialize pins.
+     *
+     * @param reset If true, sends a reset pulse to all MAX3000 displays.
+     * @param periphBegin If true, initializes the SPI object, if used.
+     * @return Returns true on success, or false if allocation fails.
+     */
+    bool begin(bool reset = true, bool periphBegin = true);
+
+    /**
+     * @brief Renders every panel, and flips the pixels that changed.
+     *
+     * The first update after begin() pulses every pixel, as the state of
+     * the dots is unknown.
+     *
+     * @param force When true, sends a pulse for every pixel.
+     */
+    void display(bool force = false);
+
+    /**
+     * @brief Enable or disable display invert mode (white-on-black text), and update every pixel.
+     *
+     * @param i If true, switch to invert mode (black-on-white), else normal mode (white-on-black).
+     */
+    virtual void invertDisplay(bool i);
+
+    /**
+     * @brief Returns the number of panels rendered but found unchanged in the last update.
+     */
+    size_t getSkippedPanels(void) const { return skippedPanels; }
+
+    using MAX3000_Base::getTimeToNextFrameUs;
+    using MAX3000_Base::setFramePeriodUs;
+    using MAX3000_Base::setPulseDurationUs;
+    using MAX3000_Base::setPulseMode;
+    using MAX3000_Base::setUserLED;
+
+  protected:
+    /**
+     * @brief Renders a group of consecutive boards, and flips their changed pixels.
+     *
+     * @param first First board of the group, in chain order.
+     * @param count Number of boards in the group.
+     * @param force When true, every pixel of the group is pulsed.
+     */
+    void updateGroup(size_t first, size_t count, bool force);
+
+    /**
+     * @brief Loads the shift register buffer with the next pulse of the group.
+     *
+     * Picks the next changed pixel of every board in the group, see
+     * MAX3000_Base::setPulseMode(). Boards outside the group are left without
+     * a source.
+     *
+     * @return Direction of the pulse, or 0 when the group is done.
+     */
+    virtual uint8_t loadNextPulse(void);
+
+    /**
+     * @brief Finds the next pixel of a board in the group that needs a pulse in one direction.
+     *
+     * Loads the decoder inputs of the pixel into the shift register buffer,
+     * and records it in the panel's physical state.
+     *
+     * @param slot Index of the board within the group.
+     * @param directions Pulse directions to look for.
+     * @return Direction of the selected pixel, or 0 if none was found.
+     */
+    uint8_t nextTilePixel(size_t slot, uint8_t directions);
+
+    MAX3000_TileRenderer renderer;
+    void * context;
+    uint8_t store;
+    uint8_t tilesAtOnce;
+
+    /** @brief Per-board physical state with MAX3000_STREAM_STATE, in the tile layout */
+    uint8_t * states;
+
+    /** @brief Per-board hash of the last tile with MAX3000_STREAM_HASH */
+    uint32_t * hashes;
+
+    /** @brief Tiles of the group being updated */
+    uint8_t * tiles;
+
+    /** @brief Per-tile position in the panel's pixels, for each direction */
+    uint16_t * tileCursors;
+
+    /** @brief Per-tile flag, set if the panel's pixels are all pulsed */
+    bool * tileForced;
+
+    /** @brief First board of the group being updated */
+    size_t groupFirst;
+
+    /** @brief Number of boards in the group being updated */
+    size_t groupCount;
+
+    size_t skippedPanels;
+};
+
+#endif    // _MAX3000_Stream_H_
@@ -0,0 +1,214 @@
+/**
+ * @file MAX3000_Transport.cpp
+ *
+ * Hardware access layer used by MAX3000_Lib to drive the MAX3000 control lines.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#include <MAX3000_Lib.h>
+
+#if !defined(__ARM_ARCH) && !defined(ENERGIA) && !defined(ESP8266) && !defined(ESP32) && !defined(__arc__) && !defined(WIRINGPI)
+#include <util/delay.h>
+#endif
+
+// Extra delay when bitbanging on ESP32, which updates much faster than AVR
+#if defined(ESP32) || defined(ESP8266) || defined(ARDUINO_ARCH_STM32)
+#define BITBANG_DELAY_US 5
+#elif defined(WIRINGPI)
+#define BITBANG_DELAY_US 8
+#else
+#define BITBANG_DELAY_US 0
+#endif
+#if BITBANG_DELAY_US
+#define BITBANG_DELAY delayMicroseconds(BITBANG_DELAY_US);
+#else
+#define BITBANG_DELAY
+#endif
+
+// Rough cost of a digitalWrite() call, used for timing estimates
+#if defined(__AVR__)
+#define PIN_WRITE_NS 4000
+#elif defined(ESP8266)
+#define PIN_WRITE_NS 1000
+#else
+#define PIN_WRITE_NS 100
+#endif
+
+#ifdef HAVE_PORTREG
+#define MAX3000_LATCH *latPort |= latPinMask;           ///< Shift Register Latch
+#define MAX3000_UNLATCH *latPort &= ~latPinMask;        ///< Shift Register Unlatch
+#define MAX3000_PULSE *pulsePort |= pulsePinMask;       ///< PULSE_ENABLE active
+#define MAX3000_UNPULSE *pulsePort &= ~pulsePinMask;    ///< PULSE_ENABLE inactive
+#define MAX3000_PULSE_ROW *rowPort &= ~rowPinMask;      ///< ROW_ENABLE_N active
+#define MAX3000_UNPULSE_ROW *rowPort |= rowPinMask;     ///< ROW_ENABLE_N inactive
+#define MAX3000_PULSE_COL *colPort &= ~colPinMask;      ///< COL_ENABLE_N active
+#define MAX3000_UNPULSE_COL *colPort |= colPinMask;     ///< COL_ENABLE_N inactive
+#else
+#define MAX3000_LATCH digitalWrite(config->lat_pin, HIGH);          ///< Shift Register Latch
+#define MAX3000_UNLATCH digitalWrite(config->lat_pin, LOW);         ///< Shift Register Unlatch
+#define MAX3000_PULSE digitalWrite(config->pulse_pin, HIGH);        ///< PULSE_ENABLE active
+#define MAX3000_UNPULSE digitalWrite(config->pulse_pin, LOW);       ///< PULSE_ENABLE inactive
+#define MAX3000_PULSE_ROW digitalWrite(config->row_pin, LOW);       ///< ROW_ENABLE_N active
+#define MAX3000_UNPULSE_ROW digitalWrite(config->row_pin, HIGH);    ///< ROW_ENABLE_N inactive
+#define MAX3000_PULSE_COL digitalWrite(config->col_pin, LOW);       ///< COL_ENABLE_N active
+#define MAX3000_UNPULSE_COL digitalWrite(config->col_pin, HIGH);    ///< COL_ENABLE_N inactive
+#endif
+
+// SPI transactions  not present in older Arduino SPI lib
+#if defined(SPI_HAS_TRANSACTION)
+#define SPI_TRANSACTION_START \
+    if(config->spi) config->spi->beginTransaction(spiSettings);    ///< Pre-SPI
+#define SPI_TRANSACTION_END \
+    if(config->spi) config->spi->endTransaction();    ///< Post-SPI
+#else
+#define SPI_TRANSACTION_START    ///< Dummy stand-in define
+#define SPI_TRANSACTION_END      ///< keeps compiler happy
+#endif
+
+MAX3000_PinTransport::MAX3000_PinTransport(void)
+    : config(NULL) {
+}
+
+bool MAX3000_PinTransport::begin(const MAX3000_Config & config_, bool periphBegin) {
+    config = &config_;
+
+#ifdef SPI_HAS_TRANSACTION
+    spiSettings = SPISettings(config->spi_bitrate, MSBFIRST, SPI_MODE0);
+#endif
+
+    // Set up hardware pin modes
+    pinMode(config->lat_pin, OUTPUT);
+    pinMode(config->rst_pin, OUTPUT);
+    pinMode(config->pulse_pin, OUTPUT);
+    pinMode(config->col_pin, OUTPUT);
+    pinMode(config->row_pin, OUTPUT);
+
+#ifdef HAVE_PORTREG
+    latPort      = (PortReg *)portOutputRegister(digitalPinToPort(config->lat_pin));
+    latPinMask   = digitalPinToBitMask(config->lat_pin);
+    pulsePort    = (PortReg *)portOutputRegister(digitalPinToPort(config->pulse_pin));
+    pulsePinMask = digitalPinToBitMask(config->pulse_pin);
+    rowPort      = (PortReg *)portOutputRegister(digitalPinToPort(config->row_pin));
+    rowPinMask   = digitalPinToBitMask(config->row_pin);
+    colPort      = (PortReg *)portOutputRegister(digitalPinToPort(config->col_pin));
+    colPinMask   = digitalPinToBitMask(config->col_pin);
+#endif
+
+    // Initialize SPI (either hardware or software)
+    if(config->spi) {
+        if(periphBegin) {
+            config->spi->begin();
+        }
+    } else {
+        pinMode(config->mosi_pin, OUTPUT);
+        pinMode(config->sclk_pin, OUTPUT);
+#ifdef HAVE_PORTREG
+        mosiPort    = (PortReg *)portOutputRegister(digitalPinToPort(config->mosi_pin));
+        mosiPinMask = digitalPinToBitMask(config->mosi_pin);
+        clkPort     = (PortReg *)portOutputRegister(digitalPinToPort(config->sclk_pin));
+        clkPinMask  = digitalPinToBitMask(config->sclk_pin);
+        *clkPort &= ~clkPinMask;
+#else
+        digitalWrite(config->sclk_pin, LOW);
+#endif
+    }
+
+    return true;
+}
+
+void MAX3000_PinTransport::shiftBits(const uint16_t * words, size_t numBoards, size_t & bitPos, size_t count) {
+    size_t endPos = bitPos + count;
+    if(endPos > numBoards * 16) {
+        endPos = numBoards * 16;
+    }
+
+    // Push each board through the chain, starting with the last board
+    SPI_TRANSACTION_START
+    while(bitPos < endPos) {
+        size_t board = bitPos / 16;
+        if(config->spi) {
+            // Hardware SPI sends whole words only
+            (void)config->spi->transfer16(words[board]);
+            bitPos = (board + 1) * 16;
+        } else {
+            uint16_t bit = 0x8000 >> (bitPos % 16);
+#ifdef HAVE_PORTREG
+            if(words[board] & bit)
+                *mosiPort |= mosiPinMask;
+            else
+                *mosiPort &= ~mosiPinMask;
+            BITBANG_DELAY
+            *clkPort |= clkPinMask;
+            BITBANG_DELAY
+            *clkPort &= ~clkPinMask;
+            BITBANG_DELAY
+#else
+            digitalWrite(config->mosi_pin, (bool)(words[board] & bit));
+            BITBANG_DELAY
+            digitalWrite(config->sclk_pin, HIGH);
+            BITBANG_DELAY
+            digitalWrite(config->sclk_pin, LOW);
+            BITBANG_DELAY
+#endif
+            bitPos++;
+        }
+    }
+    SPI_TRANSACTION_END
+}
+
+void MAX3000_PinTransport::latch(void) {
+    MAX3000_LATCH
+    MAX3000_UNLATCH
+}
+
+void MAX3000_PinTransport::setPulseEnable(bool active) {
+    if(active) {
+        MAX3000_PULSE
+    } else {
+        MAX3000_UNPULSE
+    }
+}
+
+void MAX3000_PinTransport::setRowEnable(bool active) {
+    if(active) {
+        MAX3000_PULSE_ROW
+    } else {
+        MAX3000_UNPULSE_ROW
+    }
+}
+
+void MAX3000_PinTransport::setColEnable(bool active) {
+    if(active) {
+        MAX3000_PULSE_COL
+    } else {
+        MAX3000_UNPULSE_COL
+    }
+}
+
+uint32_t MAX3000_PinTransport::estimateShiftNs(size_t bits) {
+    if(config && config->spi) {
+        // Whole words at the SPI bitrate
+        return (uint32_t)(((bits + 15) / 16) * 16 * (1000000000ULL / config->spi_bitrate));
+    }
+
+    // Three pin writes and three delays per bit
+    return (uint32_t)bits * 3 * (PIN_WRITE_NS + BITBANG_DELAY_US * 1000UL);
+}
+
+uint32_t MAX3000_PinTransport::estimatePinNs(void) {
+    return PIN_WRITE_NS;
+}
+
+void MAX3000_PinTransport::reset(void) {
+    if(config->rst_pin < 0) {
+        return;
+    }
+
+    digitalWrite(config->rst_pin, HIGH);
+    delay(1);
+    digitalWrite(config->rst_pin, LOW);
+    delay(10);
+    digitalWrite(config->rst_pin, HIGH);
+    delay(5);
+}
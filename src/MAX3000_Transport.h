@@ -0,0 +1,200 @@
+/**
+ * @file MAX3000_Transport.h
+ *
+ * Hardware access layer used by MAX3000_Lib to drive the MAX3000 control lines.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * Every pin toggle and shift register load made by \ref MAX3000_Base goes
+ * through a \ref MAX3000_Transport. The default \ref MAX3000_PinTransport
+ * drives the pins directly with digitalWrite or hardware SPI, while other
+ * implementations (such as the host simulator in MAX3000_Sim.h) can replace
+ * it to measure or emulate a display chain without hardware.
+ */
+
+#ifndef _MAX3000_Transport_H_
+#define _MAX3000_Transport_H_
+
+#if defined(ARDUINO_STM32_FEATHER)
+typedef class HardwareSPI SPIClass;
+#endif
+
+// Arduino / Raspberry Pi specific includes and macros
+#ifndef WIRINGPI
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+#else
+#include <MAX3000_Pi.h>
+#endif
+
+#if defined(__AVR__)
+typedef volatile uint8_t PortReg;
+typedef uint8_t PortMask;
+#define HAVE_PORTREG
+#elif defined(__SAM3X8E__)
+typedef volatile RwReg PortReg;
+typedef uint32_t PortMask;
+#define HAVE_PORTREG
+#elif(defined(__arm__) || defined(ARDUINO_FEATHER52)) && !defined(ARDUINO_ARCH_MBED) && !defined(ARDUINO_ARCH_RP2040)
+typedef volatile uint32_t PortReg;
+typedef uint32_t PortMask;
+#define HAVE_PORTREG
+#endif
+
+// TODO: PortReg is not working
+#undef HAVE_PORTREG
+
+class MAX3000_Config;
+
+/**
+ * @brief Interface to the control lines of a chain of MAX3000 drivers
+ */
+class MAX3000_Transport {
+  public:
+    /**
+     * @brief Virtual Destuctor
+     */
+    virtual ~MAX3000_Transport(void) {}
+
+    /**
+     * @brief Initialize pins and peripherals used by the transport.
+     *
+     * @param config \ref MAX3000_Config object containing parameters for display
+     * @param periphBegin If true, the Hardware SPI peripheral will have its
+     *                    begin() function called automatically.
+     * @return Returns true on successful initialization.
+     */
+    virtual bool begin(const MAX3000_Config & config, bool periphBegin) = 0;
+
+    /**
+     * @brief Shifts one 16-bit word per board into the driver chain.
+     *
+     * The outputs of the drivers do not change until \ref latch is called.
+     * The first word is shifted first, so ends up in the last board of the chain.
+     *
+     * @param words Array of shift register words, one per board.
+     * @param numBoards Number of boards in the chain.
+     */
+    virtual void shift(const uint16_t * words, size_t numBoards) {
+        size_t bitPos = 0;
+        shiftBits(words, numBoards, bitPos, numBoards * 16);
+    }
+
+    /**
+     * @brief Shifts part of the words for the driver chain, so it can be resumed later.
+     *
+     * Bits are sent MSB first, starting with the first word, in the same order
+     * as \ref shift. Transports that can't stop within a word may send more
+     * bits than requested, up to the next word boundary.
+     *
+     * @param words Array of shift register words, one per board.
+     * @param numBoards Number of boards in the chain.
+     * @param bitPos Index of the next bit to send, advanced by the bits sent.
+     * @param count Number of bits to send.
+     */
+    virtual void shiftBits(const uint16_t * words, size_t numBoards, size_t & bitPos, size_t count) = 0;
+
+    /**
+     * @brief Pulses MTX_LAT, moving the shifted words to the driver outputs.
+     */
+    virtual void latch(void) = 0;
+
+    /**
+     * @brief Sets the state of PULSE_ENABLE.
+     * @param active True to enable the pulse drivers.
+     */
+    virtual void setPulseEnable(bool active) = 0;
+
+    /**
+     * @brief Sets the state of ROW_ENABLE_N.
+     * @param active True to enable the row drivers (drives the pin low).
+     */
+    virtual void setRowEnable(bool active) = 0;
+
+    /**
+     * @brief Sets the state of COL_ENABLE_N.
+     * @param active True to enable the column drivers (drives the pin low).
+     */
+    virtual void setColEnable(bool active) = 0;
+
+    /**
+     * @brief Toggles MTX_RST to reset the drivers, delaying to ensure proper state.
+     */
+    virtual void reset(void) = 0;
+
+    /**
+     * @brief Busy-waits for a number of microseconds.
+     * @param us Duration in microseconds.
+     */
+    virtual void delayUs(uint32_t us) { delayMicroseconds(us); }
+
+    /**
+     * @brief Returns a free-running microsecond timestamp.
+     * @return Microseconds since an arbitrary point, wrapping at 32 bits.
+     */
+    virtual uint32_t getMicros(void) { return micros(); }
+
+    /**
+     * @brief Returns the expected duration of \ref shiftBits for a number of bits.
+     *
+     * Used to predict update durations, see MAX3000_Base::estimateDisplayTime().
+     *
+     * @param bits Number of bits to shift.
+     * @return Duration in nanoseconds, or 0 if unknown.
+     */
+    virtual uint32_t estimateShiftNs(size_t bits) {
+        (void)bits;
+        return 0;
+    }
+
+    /**
+     * @brief Returns the expected duration of a single latch or enable pin write.
+     *
+     * @return Duration in nanoseconds, or 0 if unknown.
+     */
+    virtual uint32_t estimatePinNs(void) { return 0; }
+
+    /**
+     * @brief Called by MAX3000_Base at the start of each display() update.
+     */
+    virtual void frameBegin(void) {}
+
+    /**
+     * @brief Called by MAX3000_Base at the end of each display() update.
+     */
+    virtual void frameEnd(void) {}
+};
+
+/**
+ * @brief Transport driving the MAX3000 pins directly, using bit-bang or hardware SPI
+ */
+class MAX3000_PinTransport : public MAX3000_Transport {
+  public:
+    MAX3000_PinTransport(void);
+
+    virtual bool begin(const MAX3000_Config & config, bool periphBegin);
+    virtual void shiftBits(const uint16_t * words, size_t numBoards, size_t & bitPos, size_t count);
+    virtual void latch(void);
+    virtual void setPulseEnable(bool active);
+    virtual void setRowEnable(bool active);
+    virtual void setColEnable(bool active);
+    virtual void reset(void);
+    virtual uint32_t estimateShiftNs(size_t bits);
+    virtual uint32_t estimatePinNs(void);
+
+  protected:
+    /** @brief Configuration of display drivers, set in begin() */
+    const MAX3000_Config * config;
+
+#ifdef HAVE_PORTREG
+    PortReg *mosiPort, *clkPort, *latPort, *pulsePort, *rowPort, *colPort;
+    PortMask mosiPinMask, clkPinMask, latPinMask, pulsePinMask, rowPinMask, colPinMask;
+#endif
+
+#if defined(SPI_HAS_TRANSACTION)
+    SPISettings spiSettings;
+#endif
+};
+
+#endif    // _MAX3000_Transport_H_
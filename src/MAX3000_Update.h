@@ -0,0 +1,351 @@
+/**
+ * @file MAX3000_Update.h
+ *
+ * Update loops of MAX3000_Base, templated on the geometry of the display.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * Comparing frames and picking the pixels of each pulse visit every board,
+ * and look up where its panel sits in the frame buffer. The loops here take
+ * the board count, offsets and strides from a Geometry class.
+ * MAX3000_Base::RuntimeGeometry reads them from the configuration and the
+ * board tables, and MAX3000_Static passes its compile-time constants, so
+ * the compiler folds them into its copy of each loop. Only MAX3000_Lib.cpp
+ * and MAX3000_Static.h include this file.
+ */
+
+#ifndef _MAX3000_Update_H_
+#define _MAX3000_Update_H_
+
+#include <MAX3000_Lib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define LOAD_SR(_b, _p, _e)     \
+    shiftReg[_b] &= ~(1 << _p); \
+    shiftReg[_b] |= ((_e ? HIGH : LOW) << _p);
+
+// Pulse directions used when scheduling updates
+#define PULSE_SET 0x1
+#define PULSE_CLEAR 0x2
+
+#define SCAN_NONE 0xFFFF    // No step found yet, see scanNext
+#define CLASS_NONE 0xFF     // No duration class picked yet, see pulseClass
+
+/**
+ * Stores the XOR of two byte runs into out, a machine word at a time.
+ * Returns false if the runs are identical.
+ */
+inline bool diffRun(uint8_t * out, const uint8_t * a, const uint8_t * b, size_t len) {
+    size_t i     = 0;
+    bool changed = false;
+
+#if defined(__SSE2__)
+    __m128i any = _mm_setzero_si128();
+    for(; i + 16 <= len; i += 16) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+        _mm_storeu_si128((__m128i *)(out + i), x);
+        any = _mm_or_si128(any, x);
+    }
+    changed = _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF;
+#elif defined(__ARM_NEON)
+    uint8x16_t any = vdupq_n_u8(0);
+    for(; i + 16 <= len; i += 16) {
+        uint8x16_t x = veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        vst1q_u8(out + i, x);
+        any = vorrq_u8(any, x);
+    }
+    uint64x2_t any64 = vreinterpretq_u64_u8(any);
+    changed          = (vgetq_lane_u64(any64, 0) | vgetq_lane_u64(any64, 1)) != 0;
+#endif
+
+    for(; i + sizeof(size_t) <= len; i += sizeof(size_t)) {
+        size_t wordA, wordB;
+        memcpy(&wordA, a + i, sizeof(size_t));
+        memcpy(&wordB, b + i, sizeof(size_t));
+        wordA ^= wordB;
+        memcpy(out + i, &wordA, sizeof(size_t));
+        changed |= (wordA != 0);
+    }
+    for(; i < len; ++i) {
+        out[i] = a[i] ^ b[i];
+        changed |= (out[i] != 0);
+    }
+    return changed;
+}
+
+#if PANEL_HEIGHT * PANEL_WIDTH > 1024
+#error "Dissolve permutation only covers panels of up to 1024 pixels"
+#endif
+
+/**
+ * Scrambles the bits of a 32-bit key (MurmurHash3 finalizer), so that
+ * consecutive keys give unrelated dissolve orders.
+ */
+inline uint32_t dissolveMix(uint32_t key) {
+    key ^= key >> 16;
+    key *= 0x85EBCA6BUL;
+    key ^= key >> 13;
+    key *= 0xC2B2AE35UL;
+    key ^= key >> 16;
+    return key;
+}
+
+/**
+ * Maps a position in the update order of a panel to a pixel index, as a
+ * permutation of 0 to PANEL_HEIGHT * PANEL_WIDTH - 1 selected by the key.
+ *
+ * A 4-round Feistel network over 10 bits is a permutation of 0 to 1023
+ * whatever its round function. Applying it again until the result is on
+ * the panel (cycle-walking) restricts it to a permutation of the panel's
+ * pixels, so every pixel is visited exactly once without any table.
+ */
+inline uint16_t dissolvePermute(uint16_t position, uint32_t key) {
+    uint16_t index = position;
+    do {
+        uint8_t left  = index >> 5;
+        uint8_t right = index & 0x1F;
+        for(uint8_t round = 0; round < 4; ++round) {
+            uint8_t roundKey = key >> (round * 8);
+            uint8_t f        = (uint8_t)((right ^ roundKey) * 0x35 + (roundKey >> 3));
+            uint8_t mixed    = left ^ ((f ^ (f >> 4)) & 0x1F);
+            left             = right;
+            right            = mixed;
+        }
+        index = ((uint16_t)left << 5) | right;
+    } while(index >= PANEL_HEIGHT * PANEL_WIDTH);
+    return index;
+}
+
+template <class Geometry>
+uint8_t MAX3000_Base::loadBoards(void) {
+    size_t numBoards = Geometry::numBoards(*this);
+
+    if(pulseMode == MAX3000_PULSE_COMBINED) {
+        // Set or clear the next changed pixel on each board, all in one pulse.
+        // The direction of each board is selected by its source bits.
+        bool found = false;
+        for(size_t board = 0; board < numBoards; ++board) {
+            uint8_t direction = nextPendingPixel<Geometry>(board, setCursor[board], PULSE_SET | PULSE_CLEAR);
+            LOAD_SR(board, SR_PIN_COL_SOURCE, direction == PULSE_CLEAR);
+            LOAD_SR(board, SR_PIN_ROW_SOURCE, direction == PULSE_SET);
+            if(direction) {
+                found = true;
+            }
+        }
+        return found ? (PULSE_SET | PULSE_CLEAR) : 0;
+    }
+
+    // Alternate between pulses setting and clearing pixels, until neither
+    // direction has any pixels left on any board.
+    // If no change is necessary for a board, neither row or column will
+    // be sourced and the pixel will remain in its existing state
+    for(uint8_t attempt = 0; attempt < 2; ++attempt) {
+        uint8_t direction = nextDirection;
+        nextDirection ^= (PULSE_SET | PULSE_CLEAR);
+        if(!(pendingDirections & direction)) {
+            continue;
+        }
+
+        bool found = false;
+        for(size_t board = 0; board < numBoards; ++board) {
+            // Setting -> Row Set Source, Column sink
+            // Clearing -> Column Source, Row sink
+            uint16_t & cursor = (direction == PULSE_SET) ? setCursor[board] : clearCursor[board];
+            bool boardFound   = nextPendingPixel<Geometry>(board, cursor, direction);
+            LOAD_SR(board, SR_PIN_COL_SOURCE, boardFound && direction == PULSE_CLEAR);
+            LOAD_SR(board, SR_PIN_ROW_SOURCE, boardFound && direction == PULSE_SET);
+            if(boardFound) {
+                found = true;
+            }
+        }
+        if(found) {
+            return direction;
+        }
+        pendingDirections &= ~direction;
+    }
+
+    return 0;
+}
+
+template <class Geometry>
+void MAX3000_Base::diffBoards(bool force, bool tracked, bool retarget) {
+    size_t numBoards   = Geometry::numBoards(*this);
+    size_t stride      = Geometry::pageStride(*this);
+    uint8_t invertMask = invertEnabled ? 0xFF : 0x00;
+
+    for(size_t board = 0; board < numBoards; ++board) {
+        // Untracked frames and the first update are compared in full.
+        size_t first = 0;
+        size_t last  = PANEL_WIDTH - 1;
+        if(tracked) {
+            if(!force && !firstUpdate && !bufferUntracked) {
+                first = dirtyFirst[board];
+                last  = dirtyLast[board];
+            }
+            dirtyFirst[board] = PANEL_WIDTH;
+            dirtyLast[board]  = 0;
+        }
+
+        // Boards that weren't drawn on since the last update can't have changed.
+        // When retargeting, their pixels still pending are left as they are.
+        uint8_t * boardPending = &pending[board * PANEL_PENDING_BYTES];
+        if(!retarget) {
+            pendingSet[board]   = 0;
+            pendingClear[board] = 0;
+            memset(boardPending, 0, PANEL_PENDING_BYTES);
+        }
+        if(first > last) {
+            continue;
+        }
+
+        // A whole panel stored contiguously is compared in a single run
+        size_t length = last - first + 1;
+        size_t runs   = PANEL_HEIGHT / 8;
+        if(stride == PANEL_WIDTH && length == PANEL_WIDTH) {
+            length = PANEL_PENDING_BYTES;
+            runs   = 1;
+        }
+
+        for(size_t page = 0; page < runs; ++page) {
+            size_t bufferOffset = Geometry::boardOffset(*this, board) + page * stride + first;
+            uint8_t * mask      = &boardPending[page * PANEL_WIDTH + first];
+
+            // The drawing buffer holds the frame before last, so catch it up
+            // with the columns drawn since.
+            if(tracked && buffer != frontBuffer) {
+                memcpy(&buffer[bufferOffset], &frontBuffer[bufferOffset], length);
+            }
+
+            // Pixels pulsed so far are already in the physical state, so
+            // pixels that reverted to it drop out of the pending mask.
+            if(force || firstUpdate) {
+                memset(mask, 0xFF, length);
+            } else {
+                diffRun(mask, &targetBuffer[bufferOffset], &oldBuffer[bufferOffset], length);
+            }
+        }
+
+        // Count the changes in each direction, so boards without any
+        // can be skipped while scheduling. Pixels of the cell outside the
+        // board's panel variant are dropped here, so they are never pulsed.
+        const uint8_t * boardTarget = &targetBuffer[Geometry::boardOffset(*this, board)];
+        const uint8_t * present     = boardTypes[board]->present;
+        pendingSet[board]           = 0;
+        pendingClear[board]         = 0;
+        for(size_t page = 0; page < PANEL_HEIGHT / 8; ++page) {
+            for(size_t col = 0; col < PANEL_WIDTH; ++col) {
+                uint8_t mask = (boardPending[page * PANEL_WIDTH + col] &= pgm_read_byte(&present[page * PANEL_WIDTH + col]));
+                if(mask) {
+                    uint8_t setBits = mask & (boardTarget[page * stride + col] ^ invertMask);
+                    pendingSet[board] += __builtin_popcount(setBits);
+                    pendingClear[board] += __builtin_popcount(mask & ~setBits);
+                }
+            }
+        }
+    }
+}
+
+template <class Geometry>
+uint8_t MAX3000_Base::nextPendingPixel(size_t board, uint16_t & cursor, uint8_t directions) {
+    // Skip the board entirely once it has nothing left in the requested directions
+    if(!((directions & PULSE_SET) && pendingSet[board]) && !((directions & PULSE_CLEAR) && pendingClear[board])) {
+        return 0;
+    }
+
+    // Each board dissolves in its own order
+    uint32_t boardKey           = dissolveEnabled ? dissolveMix(dissolveKey + board * 0x85EBCA6BUL) : 0;
+    const uint8_t * boardBuffer = &targetBuffer[Geometry::boardOffset(*this, board)];
+    uint8_t * boardState        = &oldBuffer[Geometry::boardOffset(*this, board)];
+    uint8_t * boardPending      = &pending[board * PANEL_PENDING_BYTES];
+    size_t stride               = Geometry::pageStride(*this);
+    size_t slot                 = board * 2 + (directions == PULSE_CLEAR);
+    bool calibrated             = Geometry::CALIBRATED && calibration;
+
+    while(cursor < PANEL_HEIGHT * PANEL_WIDTH) {
+        // When updating sequentially, skip over columns without changes
+        if(!dissolveEnabled && (cursor % PANEL_HEIGHT) == 0) {
+            size_t col = cursor / PANEL_HEIGHT;
+            if(!boardPending[col] && !boardPending[col + PANEL_WIDTH]) {
+                cursor += PANEL_HEIGHT;
+                continue;
+            }
+        }
+
+        // If dissolving, pick the permuted index
+        int index = (dissolveEnabled) ? dissolvePermute(cursor, boardKey) : cursor;
+        cursor++;
+
+        size_t col     = (index / PANEL_HEIGHT);
+        size_t row     = (index % PANEL_HEIGHT);
+        uint8_t bit    = 1 << (row & 7);
+        uint8_t & mask = boardPending[col + (row / 8) * PANEL_WIDTH];
+        if(!(mask & bit)) {
+            continue;
+        }
+
+        // With a scan order, only pick pixels of the current step, and note
+        // the closest later step for when the current one is done.
+        if(scanOrder) {
+            uint16_t step = scanOrder->step(Geometry::originX(*this, board) + col, Geometry::originY(*this, board) + row,
+                Geometry::width(*this), Geometry::height(*this));
+            if(step != scanStep) {
+                if(step > scanStep && step < scanNext[board]) {
+                    scanNext[board] = step;
+                }
+                continue;
+            }
+        }
+
+        // Only pick pixels being driven in the requested direction
+        size_t offset     = col + (row / 8) * stride;
+        bool newPixVal    = boardBuffer[offset] & bit;
+        uint8_t direction = (newPixVal != invertEnabled) ? PULSE_SET : PULSE_CLEAR;
+        if(!(direction & directions)) {
+            continue;
+        }
+
+        // With a calibration, only pick pixels of the cursor's duration
+        // class, and note the others for a later pass. The pulse lasts as
+        // long as its slowest pixel needs.
+        if(calibrated) {
+            uint8_t durationClass = pixelClass(board, row, col);
+            if(durationClass != cursorClass[slot]) {
+                classPassed[slot] |= 1 << durationClass;
+                continue;
+            }
+            if(pulseClass == CLASS_NONE || calibration->getClassDurationUs(durationClass) > calibration->getClassDurationUs(pulseClass)) {
+                pulseClass = durationClass;
+            }
+        }
+
+        // Track the physical state pixel by pixel, so it stays correct
+        // even if the update doesn't run to completion.
+        if(!planning) {
+            boardState[offset] = (boardState[offset] & ~bit) | (boardBuffer[offset] & bit);
+        }
+        mask &= ~bit;
+        if(direction == PULSE_SET) {
+            pendingSet[board]--;
+        } else {
+            pendingClear[board]--;
+        }
+
+        // Pre-select the decoder inputs for the board.
+        selectRowColumn(board, row, col);
+        return direction;
+    }
+
+    // Start over with the slowest class passed over. The first pass of each
+    // cursor only notes the classes present, so the slowest goes first.
+    if(calibrated && nextCursorClass(slot, cursor)) {
+        return nextPendingPixel<Geometry>(board, cursor, directions);
+    }
+    return 0;
+}
+
+#endif    // _MAX3000_Update_H_
@@ -0,0 +1,222 @@
+/**
+ * @file MAX3000_Wall.cpp
+ *
+ * Coordinator of a display wall driven by several chains, for Linux hosts.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ */
+
+#ifdef WIRINGPI
+#include <MAX3000_Wall.h>
+#include <sys/mman.h>
+
+MAX3000_Wall::MAX3000_Wall(uint16_t width, uint16_t height)
+    : wallWidth(((width + (PANEL_WIDTH - 1)) / PANEL_WIDTH) * PANEL_WIDTH),
+      wallHeight(((height + (PANEL_HEIGHT - 1)) / PANEL_HEIGHT) * PANEL_HEIGHT),
+      buffer(NULL),
+      running(false),
+      stopping(false),
+      forceUpdate(false) {
+    sem_init(&done, 0, 0);
+}
+
+MAX3000_Wall::~MAX3000_Wall(void) {
+    stop();
+    for(size_t i = 0; i < chains.size(); ++i) {
+        sem_destroy(&chains[i]->wake);
+        delete chains[i];
+    }
+    sem_destroy(&done);
+    delete[] buffer;
+}
+
+bool MAX3000_Wall::addChain(MAX3000_Base & chain, uint16_t x, uint16_t y, const MAX3000_EngineOptions & options) {
+    if(running || (x % PANEL_WIDTH) || (y % PANEL_HEIGHT) ||
+        (size_t)x + chain.config.width > wallWidth || (size_t)y + chain.config.height > wallHeight) {
+        return false;
+    }
+
+    Chain * entry  = new Chain();
+    entry->display = &chain;
+    entry->x       = x;
+    entry->y       = y;
+    entry->options = options;
+    entry->timing  = MAX3000_ChainTiming();
+    entry->changed = false;
+    sem_init(&entry->wake, 0, 0);
+    chains.push_back(entry);
+    return true;
+}
+
+bool MAX3000_Wall::start(void) {
+    if(running) {
+        return true;
+    }
+
+    if((!buffer) && !(buffer = new uint8_t[wallWidth * (wallHeight / 8)])) {
+        return false;
+    }
+    memset(buffer, 0, wallWidth * (wallHeight / 8));
+
+    bool lockMemory = false;
+    for(size_t i = 0; i < chains.size(); ++i) {
+        lockMemory = lockMemory || chains[i]->options.lockMemory;
+    }
+    if(lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        return false;
+    }
+
+    stopping = false;
+    running  = true;
+    for(size_t i = 0; i < chains.size(); ++i) {
+        Chain & chain = *chains[i];
+        chain.timing  = MAX3000_ChainTiming();
+        chain.changed = true;    // The dots start in an unknown state
+        try {
+            chain.thread = std::thread(&MAX3000_Wall::run, this, std::ref(chain));
+        } catch(const std::system_error &) {
+            stop();
+            return false;
+        }
+
+        // Scheduling is applied from here, so failures can be reported.
+        if(!chain.options.apply(chain.thread)) {
+            stop();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MAX3000_Wall::stop(void) {
+    stopping = true;
+    for(size_t i = 0; i < chains.size(); ++i) {
+        if(chains[i]->thread.joinable()) {
+            sem_post(&chains[i]->wake);
+            chains[i]->thread.join();
+        }
+    }
+    running = false;
+}
+
+void MAX3000_Wall::display(bool force) {
+    if(!running) {
+        return;
+    }
+
+    // Copy on this thread, so drawing can't race the chains' buffers
+    size_t started = 0;
+    forceUpdate    = force;
+    for(size_t i = 0; i < chains.size(); ++i) {
+        Chain & chain = *chains[i];
+        chain.changed = copyChain(chain) || chain.changed;
+        if(chain.changed || force) {
+            chain.changed = false;
+            sem_post(&chain.wake);
+            started++;
+        } else {
+            chain.timing.lastUs = 0;
+        }
+    }
+
+    while(started) {
+        if(sem_wait(&done) == 0) {
+            started--;
+        }
+    }
+}
+
+void MAX3000_Wall::run(Chain & chain) {
+    MAX3000_Base & display = *chain.display;
+    while(!stopping) {
+        if(sem_wait(&chain.wake) != 0) {
+            continue;    // EINTR
+        }
+        if(stopping) {
+            break;
+        }
+
+        uint32_t start = display.transport->getMicros();
+        display.display(forceUpdate);
+        uint32_t duration = display.transport->getMicros() - start;
+
+        chain.timing.lastUs = duration;
+        if(duration > chain.timing.worstUs) {
+            chain.timing.worstUs = duration;
+        }
+        chain.timing.totalUs += duration;
+        chain.timing.updates++;
+        sem_post(&done);
+    }
+}
+
+bool MAX3000_Wall::copyChain(Chain & chain) {
+    MAX3000_Base & display = *chain.display;
+    size_t numH            = display.config.numHBoards;
+    bool changed           = false;
+
+    for(size_t board = 0; board < numH * display.config.numVBoards; ++board) {
+        size_t panelX        = display.boardPanels[board] % numH;
+        size_t panelY        = display.boardPanels[board] / numH;
+        size_t wallX         = chain.x + panelX * PANEL_WIDTH;
+        size_t wallY         = chain.y + panelY * PANEL_HEIGHT;
+        const uint8_t * from = &buffer[wallX + (wallY / 8) * wallWidth];
+        uint8_t * to         = &display.buffer[display.boardOffset(board)];
+
+        // Panels are two pages of 8 rows each
+        for(size_t page = 0; page < PANEL_HEIGHT / 8; ++page) {
+            if(memcmp(to, from, PANEL_WIDTH)) {
+                memcpy(to, from, PANEL_WIDTH);
+                display.markDirty(panelX * PANEL_WIDTH, panelY * PANEL_HEIGHT + page * 8, PANEL_WIDTH, 8);
+                changed = true;
+            }
+            from += wallWidth;
+            to += display.pageStride;
+        }
+    }
+    return changed;
+}
+
+void MAX3000_Wall::drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if((x < 0) || (x >= wallWidth) || (y < 0) || (y >= wallHeight) || !buffer) {
+        return;
+    }
+
+    uint8_t & pixels = buffer[x + (y / 8) * wallWidth];
+    switch(color) {
+        case MAX3000_LIGHT:
+            pixels |= (1 << (y & 7));
+            break;
+        case MAX3000_DARK:
+            pixels &= ~(1 << (y & 7));
+            break;
+        case MAX3000_INVERSE:
+            pixels ^= (1 << (y & 7));
+            break;
+    }
+}
+
+bool MAX3000_Wall::getPixel(int16_t x, int16_t y) const {
+    if((x < 0) || (x >= wallWidth) || (y < 0) || (y >= wallHeight) || !buffer) {
+        return false;
+    }
+    return (buffer[x + (y / 8) * wallWidth] & (1 << (y & 7))) != 0;
+}
+
+void MAX3000_Wall::clearDisplay(void) {
+    if(buffer) {
+        memset(buffer, 0, wallWidth * (wallHeight / 8));
+    }
+}
+
+uint32_t MAX3000_Wall::getLastDisplayUs(void) const {
+    uint32_t longest = 0;
+    for(size_t i = 0; i < chains.size(); ++i) {
+        if(chains[i]->timing.lastUs > longest) {
+            longest = chains[i]->timing.lastUs;
+        }
+    }
+    return longest;
+}
+#endif
@@ -0,0 +1,205 @@
+/**
+ * @file MAX3000_Wall.h
+ *
+ * Coordinator of a display wall driven by several chains, for Linux hosts.
+ *
+ * For use with https://github.com/NietoSkunk/FlippyDriver MAX3000 Driver.
+ *
+ * Every pulse of an update is preceded by shifting a word through each board
+ * of the chain, so the longer the chain, the longer each pulse waits. A wall
+ * split into several shorter chains, each with its own pins and transport,
+ * shifts them all at the same time.
+ *
+ * MAX3000_Wall holds one frame buffer for the whole wall, and each chain is
+ * placed on a rectangle of its panels. display() copies each chain's panels
+ * into that chain's buffer, and updates all chains at once on a thread per
+ * chain, returning when the last one is done. The duration of each chain's
+ * updates is reported from its transport's clock.
+ *
+ * Only built with -DWIRINGPI.
+ */
+
+#ifndef _MAX3000_Wall_H_
+#define _MAX3000_Wall_H_
+
+#include <MAX3000_Engine.h>
+#include <MAX3000_Lib.h>
+
+#include <vector>
+
+/**
+ * @brief Durations of a chain's updates, as measured by its transport
+ */
+struct MAX3000_ChainTiming {
+    uint32_t lastUs;     // Duration of the last update, 0 if the chain had nothing to update
+    uint32_t worstUs;    // Longest update since the wall started
+    uint64_t totalUs;    // Sum of all updates since the wall started
+    uint32_t updates;    // Number of updates since the wall started
+};
+
+/**
+ * @brief Single frame buffer for a wall of MAX3000 chains, updated concurrently
+ */
+class MAX3000_Wall {
+  public:
+    /**
+     * @brief Constructs a wall of the given size.
+     *
+     * The width and height are rounded up to whole panels, as in MAX3000_Config.
+     *
+     * @param width Total width of the wall in pixels.
+     * @param height Total height of the wall in pixels.
+     */
+    MAX3000_Wall(uint16_t width, uint16_t height);
+
+    /**
+     * @brief Destructor, stops the chain threads.
+     */
+    ~MAX3000_Wall(void);
+
+    /**
+     * @brief Places a chain on the wall.
+     *
+     * The chain covers the rectangle of its own configured size at the given
+     * position, which must lie on panel boundaries. Chains must not overlap,
+     * and should be started with begin() and left unrotated. The chain must
+     * outlive the wall. Add all chains before \ref start.
+     *
+     * @param chain Display driving the chain.
+     * @param x Left column of the chain on the wall, a multiple of PANEL_WIDTH.
+     * @param y Top row of the chain on the wall, a multiple of PANEL_HEIGHT.
+     * @param options Scheduling options of the chain's thread.
+     * @return Returns false if the chain doesn't fit on the wall.
+     */
+    bool addChain(MAX3000_Base & chain, uint16_t x, uint16_t y,
+        const MAX3000_EngineOptions & options = MAX3000_EngineOptions());
+
+    /**
+     * @brief Allocates the frame buffer, and starts a thread for each chain.
+     *
+     * While the wall is running, the chains' own display() must not be called.
+     *
+     * @return Returns true if the buffer was allocated and every thread
+     *         started with all requested options.
+     */
+    bool start(void);
+
+    /**
+     * @brief Stops the chain threads.
+     */
+    void stop(void);
+
+    /**
+     * @brief Updates all chains with the frame buffer, and waits until they are done.
+     *
+     * Only chains with panels drawn since their last update compare their
+     * pixels again.
+     *
+     * @param force When true, sends a pulse for every pixel of every chain.
+     */
+    void display(bool force = false);
+
+    /**
+     * @brief Set/clear/invert a single pixel.
+     *
+     * @param x Column of the wall -- 0 at left to (width - 1) at right.
+     * @param y Row of the wall -- 0 at top to (height - 1) at bottom.
+     * @param color Pixel color, one of: MAX3000_LIGHT, MAX3000_DARK, or MAX3000_INVERSE.
+     */
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+
+    /**
+     * @brief Return color of a single pixel in the frame buffer.
+     *
+     * @param x Column of the wall -- 0 at left to (width - 1) at right.
+     * @param y Row of the wall -- 0 at top to (height - 1) at bottom.
+     * @return true if pixel is set.
+     */
+    bool getPixel(int16_t x, int16_t y) const;
+
+    /**
+     * @brief Clear contents of the frame buffer (set all pixels to off).
+     */
+    void clearDisplay(void);
+
+    /**
+     * @brief Get base address of the frame buffer for direct reading or writing.
+     *
+     * The buffer has the MAX3000_LAYOUT_PAGED layout over the whole wall:
+     * each byte holds 8 rows of one column, and each page of 8 rows spans
+     * the whole width. Available once the wall is started.
+     */
+    uint8_t * getBuffer(void) { return buffer; }
+
+    /**
+     * @brief Returns the width of the wall in pixels.
+     */
+    uint16_t width(void) const { return wallWidth; }
+
+    /**
+     * @brief Returns the height of the wall in pixels.
+     */
+    uint16_t height(void) const { return wallHeight; }
+
+    /**
+     * @brief Returns the number of chains placed on the wall.
+     */
+    size_t getChainCount(void) const { return chains.size(); }
+
+    /**
+     * @brief Returns the durations of a chain's updates.
+     *
+     * @param chain Index of the chain, in the order they were added.
+     */
+    const MAX3000_ChainTiming & getChainTiming(size_t chain) const { return chains[chain]->timing; }
+
+    /**
+     * @brief Returns the duration of the last update of the whole wall.
+     *
+     * Chains update at the same time, so this is the duration of the
+     * slowest chain, excluding the copy into the chains' buffers.
+     */
+    uint32_t getLastDisplayUs(void) const;
+
+  protected:
+    /**
+     * @brief A chain, its place on the wall and its thread
+     */
+    struct Chain {
+        MAX3000_Base * display;
+        uint16_t x;
+        uint16_t y;
+        MAX3000_EngineOptions options;
+        MAX3000_ChainTiming timing;
+        bool changed;    // Set while the chain has panels to update
+        sem_t wake;
+        std::thread thread;
+    };
+
+    /**
+     * @brief Main loop of a chain thread.
+     */
+    void run(Chain & chain);
+
+    /**
+     * @brief Copies a chain's panels from the frame buffer into its buffer.
+     *
+     * Panels that didn't change are left alone, so the chain's own tracking
+     * of drawn columns stays accurate.
+     *
+     * @return Returns true if any panel changed.
+     */
+    bool copyChain(Chain & chain);
+
+    uint16_t wallWidth;
+    uint16_t wallHeight;
+    uint8_t * buffer;
+
+    std::vector<Chain *> chains;
+    sem_t done;
+    bool running;
+    std::atomic<bool> stopping;
+    bool forceUpdate;
+};
+
+#endif    // _MAX3000_Wall_H_
@@ -0,0 +1,681 @@
+/**************************************************************************
+ Checks display updates against the display simulator. Run by ctest on
+ hosts built with MAX3000_SIMULATOR.
+
+ Every check compares the simulated dots with the frame buffer, mapping
+ each board to its panel with the board order, orientation and variant
+ independently of the library, and fails on any mismatch, fault or
+ unexpected pulse count. Exits with the number of failed checks.
+ **************************************************************************/
+
+#include <MAX3000_Engine.h>
+#include <MAX3000_Lib.h>
+#include <MAX3000_Scheduler.h>
+#include <MAX3000_Sim.h>
+#include <MAX3000_Static.h>
+#include <MAX3000_Stream.h>
+#include <MAX3000_Wall.h>
+#include <stdio.h>
+
+#define CHECK(_cond) check((_cond), #_cond, __FILE__, __LINE__)
+
+static int failures = 0;
+
+static void check(bool passed, const char * condition, const char * file, int line) {
+    if(!passed) {
+        printf("%s:%d: check failed: %s\n", file, line, condition);
+        failures++;
+    }
+}
+
+/**
+ * Returns the panel position of a board in the chain, by the board order.
+ */
+static void panelOf(const MAX3000_Config & config, size_t board, size_t & panelX, size_t & panelY) {
+    size_t across = config.numHBoards, down = config.numVBoards;
+    switch(config.boardOrder) {
+        case MAX3000_ORDER_ROW_MAJOR_BOUNCE:
+            panelY = board / across;
+            panelX = (panelY & 1) ? across - 1 - board % across : board % across;
+            break;
+        case MAX3000_ORDER_COL_MAJOR:
+            panelX = board / down;
+            panelY = board % down;
+            break;
+        case MAX3000_ORDER_COL_MAJOR_BOUNCE:
+            panelX = board / down;
+            panelY = (panelX & 1) ? down - 1 - board % down : board % down;
+            break;
+        default:
+            panelX = board % across;
+            panelY = board / across;
+            break;
+    }
+}
+
+/**
+ * Counts dots of a simulated chain that don't match a frame, read with getPixel.
+ */
+template <typename Frame>
+static size_t countMismatches(const MAX3000_SimTransport & sim, const MAX3000_Config & config, Frame & frame,
+    uint16_t originX = 0, uint16_t originY = 0) {
+    size_t mismatches = 0;
+    for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
+        size_t panelX, panelY;
+        panelOf(config, board, panelX, panelY);
+        const MAX3000_Panel * panel = (config.panelTypes && config.panelTypes[board]) ? config.panelTypes[board] : &MAX3000_PANEL_28X16;
+        uint8_t orientation         = config.boardOrientations ? config.boardOrientations[board] : MAX3000_ORIENT_UPRIGHT;
+        for(uint8_t col = 0; col < panel->width; ++col) {
+            for(uint8_t row = 0; row < panel->height; ++row) {
+                uint8_t cellCol = (orientation & MAX3000_ORIENT_MIRROR_X) ? panel->width - 1 - col : col;
+                uint8_t cellRow = (orientation & MAX3000_ORIENT_MIRROR_Y) ? panel->height - 1 - row : row;
+                bool pixel      = frame.getPixel(originX + panelX * PANEL_WIDTH + cellCol, originY + panelY * PANEL_HEIGHT + cellRow);
+                if(sim.getDot(board, row, col) != pixel) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+static void drawSlide(MAX3000_Display & display, int slide) {
+    for(int16_t x = 0; x < display.width(); ++x) {
+        for(int16_t y = 0; y < display.height(); ++y) {
+            display.drawPixel(x, y, ((x * (slide + 1) + y * (slide + 3)) % 7) < 3 ? MAX3000_LIGHT : MAX3000_DARK);
+        }
+    }
+}
+
+static void drawCheckerboard(MAX3000_Display & display, int phase) {
+    for(int16_t x = 0; x < display.width(); ++x) {
+        for(int16_t y = 0; y < display.height(); ++y) {
+            display.drawPixel(x, y, ((x + y + phase) & 1) ? MAX3000_LIGHT : MAX3000_DARK);
+        }
+    }
+}
+
+/**
+ * Simulated display of a number of panels, cleared with a forced update.
+ */
+struct Rig {
+    Rig(size_t across, size_t down, const MAX3000_SimTiming & timing = MAX3000_SimTiming())
+        : sim(timing),
+          config(across * PANEL_WIDTH, down * PANEL_HEIGHT, 0, 1, 2, 3, 4, 5, 6),
+          display(NULL) {
+        config.transport = &sim;
+    }
+
+    ~Rig(void) { delete display; }
+
+    bool begin(void) {
+        display = new MAX3000_Display(config);
+        if(!display->begin()) {
+            return false;
+        }
+        display->display(true);
+        sim.resetStats();
+        return true;
+    }
+
+    size_t mismatches(void) { return countMismatches(sim, config, *display); }
+
+    MAX3000_SimTransport sim;
+    MAX3000_Config config;
+    MAX3000_Display * display;
+};
+
+/**
+ * Counts the dots that differ between the simulators of two rigs of the same size.
+ */
+static size_t countDifferences(const Rig & a, const Rig & b) {
+    size_t differences = 0;
+    for(size_t board = 0; board < a.config.numHBoards * a.config.numVBoards; ++board) {
+        for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+            for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+                differences += a.sim.getDot(board, row, col) != b.sim.getDot(board, row, col);
+            }
+        }
+    }
+    return differences;
+}
+
+static void testTransport(void) {
+    // Every board sets half its pixels, one pixel of each board per pulse
+    Rig rig(3, 2);
+    CHECK(rig.begin());
+    drawCheckerboard(*rig.display, 0);
+    rig.display->display();
+    CHECK(rig.mismatches() == 0);
+    CHECK(rig.sim.getTotalStats().faults == 0);
+    CHECK(rig.sim.getTotalStats().pulses == PANEL_WIDTH * PANEL_HEIGHT / 2);
+    CHECK(rig.sim.getTotalStats().flips == 6 * PANEL_WIDTH * PANEL_HEIGHT / 2);
+
+    // Inverting it sets and clears half the pixels of every board
+    rig.sim.resetStats();
+    drawCheckerboard(*rig.display, 1);
+    rig.display->display();
+    CHECK(rig.mismatches() == 0);
+    CHECK(rig.sim.getTotalStats().pulses == PANEL_WIDTH * PANEL_HEIGHT);
+
+    // An unchanged frame sends nothing
+    rig.sim.resetStats();
+    rig.display->display();
+    CHECK(rig.sim.getTotalStats().pulses == 0);
+}
+
+static void testPulseModes(void) {
+    // Board 0 sets 20 pixels while board 1 clears 20: combined pulses share them
+    for(uint8_t mode = MAX3000_PULSE_SEPARATE; mode <= MAX3000_PULSE_COMBINED; ++mode) {
+        Rig rig(2, 1);
+        CHECK(rig.begin());
+        rig.display->setPulseMode(mode);
+        for(int16_t x = 0; x < 20; ++x) {
+            rig.display->drawPixel(PANEL_WIDTH + x, 3, MAX3000_LIGHT);
+        }
+        rig.display->display();
+        rig.sim.resetStats();
+        for(int16_t x = 0; x < 20; ++x) {
+            rig.display->drawPixel(x, 5, MAX3000_LIGHT);
+            rig.display->drawPixel(PANEL_WIDTH + x, 3, MAX3000_DARK);
+        }
+        rig.display->display();
+        CHECK(rig.mismatches() == 0);
+        CHECK(rig.sim.getTotalStats().faults == 0);
+        CHECK(rig.sim.getTotalStats().pulses == ((mode == MAX3000_PULSE_COMBINED) ? 20u : 40u));
+    }
+}
+
+static void testPulseWindows(void) {
+    // Shifting during the pulse must not shorten it, or latch while it is open
+    MAX3000_SimTiming spi;
+    spi.spiWordNs = 2000;
+    for(int timing = 0; timing < 2; ++timing) {
+        Rig rig(4, 1, timing ? spi : MAX3000_SimTiming());
+        CHECK(rig.begin());
+        rig.sim.setFlipThresholdUs(250);
+        drawSlide(*rig.display, 1);
+        rig.display->display();
+        CHECK(rig.mismatches() == 0);
+        CHECK(rig.sim.getTotalStats().faults == 0);
+        CHECK(rig.sim.getTotalStats().weakPulses == 0);
+    }
+}
+
+static void testDirtyTracking(void) {
+    for(uint8_t layout = MAX3000_LAYOUT_PAGED; layout <= MAX3000_LAYOUT_PANEL; ++layout) {
+        for(uint8_t mode = MAX3000_BUFFER_SINGLE; mode <= MAX3000_BUFFER_DOUBLE; ++mode) {
+            Rig rig(3, 2);
+            rig.config.bufferLayout = layout;
+            rig.config.bufferMode   = mode;
+            CHECK(rig.begin());
+            for(int frame = 0; frame < 4; ++frame) {
+                drawSlide(*rig.display, frame);
+                rig.display->display();
+                CHECK(rig.mismatches() == 0);
+            }
+
+            // A single pixel sends a single pulse
+            rig.sim.resetStats();
+            rig.display->drawPixel(40, 20, !rig.display->getPixel(40, 20));
+            rig.display->display();
+            CHECK(rig.mismatches() == 0);
+            CHECK(rig.sim.getTotalStats().pulses == 1);
+
+            // Writes through a kept buffer pointer are seen until it is released
+            uint8_t * buffer = rig.display->getBuffer();
+            buffer[7] ^= 0x81;
+            rig.display->display();
+            CHECK(rig.mismatches() == 0);
+            buffer = rig.display->getBuffer();
+            buffer[9] ^= 0x3C;
+            rig.display->display();
+            CHECK(rig.mismatches() == 0);
+            rig.display->releaseBuffer();
+            rig.sim.resetStats();
+            rig.display->display();
+            CHECK(rig.sim.getTotalStats().pulses == 0);
+        }
+    }
+}
+
+static void testSteps(void) {
+    // Updates split into steps of a budget, and retargeted by newer frames
+    Rig rig(3, 2);
+    CHECK(rig.begin());
+    size_t steps = 0;
+    for(int frame = 0; frame < 4; ++frame) {
+        drawSlide(*rig.display, frame);
+        rig.display->displayBegin();
+        while(rig.display->displayStep(20000)) {
+            steps++;
+        }
+        CHECK(rig.mismatches() == 0);
+    }
+    CHECK(steps > 4);
+
+    for(int frame = 0; frame < 8; ++frame) {
+        drawSlide(*rig.display, frame);
+        rig.display->displayBegin();
+        rig.display->displayStep(20000);
+    }
+    while(rig.display->displayStep(20000)) {
+    }
+    CHECK(rig.mismatches() == 0);
+    CHECK(rig.sim.getTotalStats().faults == 0);
+}
+
+static void testPacing(void) {
+    // Updates start one period apart, to the microsecond of the clock
+    Rig rig(2, 1);
+    CHECK(rig.begin());
+    rig.display->setFramePeriodUs(500000);
+    uint64_t lastStart = 0;
+    for(int frame = 0; frame < 4; ++frame) {
+        drawSlide(*rig.display, frame);
+        rig.display->display();
+        CHECK(rig.mismatches() == 0);
+        uint64_t start = rig.sim.getNowNs() - rig.sim.getFrameStats().totalNs;
+        if(frame > 0) {
+            CHECK(start - lastStart + 1000 >= 500000000ULL);
+        }
+        lastStart = start;
+    }
+}
+
+static void testPlans(void) {
+    // A plan reports the pulses it sends
+    Rig rig(3, 2);
+    CHECK(rig.begin());
+    MAX3000_Plan plan;
+    drawSlide(*rig.display, 1);
+    CHECK(rig.display->plan(plan));
+    CHECK(rig.display->execute(plan));
+    CHECK(rig.mismatches() == 0);
+    CHECK(rig.sim.getTotalStats().pulses == plan.getPulseCount());
+    CHECK(!rig.display->execute(plan));
+
+    // Transitions are planned when they repeat, and replayed from then on
+    MAX3000_PlanCache cache(4);
+    rig.display->setPlanCache(&cache);
+    for(int frame = 0; frame < 12; ++frame) {
+        drawSlide(*rig.display, frame % 3);
+        rig.display->display();
+        CHECK(rig.mismatches() == 0);
+    }
+    CHECK(cache.getMisses() == 7);
+    CHECK(cache.getHits() == 5);
+
+    // Planning leaves the dissolve order of the next update as it was
+    Rig planned(3, 2), unplanned(3, 2);
+    CHECK(planned.begin());
+    CHECK(unplanned.begin());
+    planned.display->setDissolveEnable(true);
+    unplanned.display->setDissolveEnable(true);
+    drawSlide(*planned.display, 2);
+    drawSlide(*unplanned.display, 2);
+    CHECK(planned.display->plan(plan));
+    planned.display->displayBegin();
+    unplanned.display->displayBegin();
+    for(int pulse = 0; pulse < 8; ++pulse) {
+        planned.display->displayStep(0);
+        unplanned.display->displayStep(0);
+    }
+    CHECK(countDifferences(planned, unplanned) == 0);
+    rig.display->setPlanCache(NULL);
+
+    // A replayed frame carries over into the next drawing when double buffered
+    Rig doubled(3, 2), reference(3, 2);
+    doubled.config.bufferMode = MAX3000_BUFFER_DOUBLE;
+    CHECK(doubled.begin());
+    CHECK(reference.begin());
+    cache.clear();
+    doubled.display->setPlanCache(&cache);
+    for(int frame = 0; frame < 7; ++frame) {
+        drawSlide(*doubled.display, frame % 2);
+        drawSlide(*reference.display, frame % 2);
+        doubled.display->display();
+        reference.display->display();
+    }
+    CHECK(cache.getHits() == 2);
+    doubled.display->drawPixel(3, 4, MAX3000_INVERSE);
+    reference.display->drawPixel(3, 4, MAX3000_INVERSE);
+    doubled.display->display();
+    reference.display->display();
+    CHECK(countDifferences(doubled, reference) == 0);
+
+    // Custom orders aren't cached
+    static const MAX3000_BuiltinScan custom(MAX3000_SCAN_SPIRAL);
+    uint32_t misses = cache.getMisses();
+    doubled.display->setScanOrder(&custom);
+    for(int frame = 0; frame < 4; ++frame) {
+        drawSlide(*doubled.display, frame % 2);
+        doubled.display->display();
+        CHECK(doubled.mismatches() == 0);
+    }
+    CHECK(cache.getMisses() == misses);
+    doubled.display->setPlanCache(NULL);
+}
+
+static void testScanOrders(void) {
+    // Every order and dissolving flips the same pixels
+    Rig reference(3, 2);
+    CHECK(reference.begin());
+    drawSlide(*reference.display, 2);
+    reference.display->display();
+    uint32_t flips = reference.sim.getTotalStats().flips;
+
+    for(uint8_t scan = MAX3000_SCAN_SEQUENTIAL; scan <= MAX3000_SCAN_TEXT; ++scan) {
+        for(int dissolve = 0; dissolve < 2; ++dissolve) {
+            Rig rig(3, 2);
+            CHECK(rig.begin());
+            rig.display->setScanOrder(scan);
+            rig.display->setDissolveEnable(dissolve);
+            drawSlide(*rig.display, 2);
+            rig.display->display();
+            CHECK(rig.mismatches() == 0);
+            CHECK(rig.sim.getTotalStats().flips == flips);
+            CHECK(rig.sim.getTotalStats().faults == 0);
+        }
+    }
+}
+
+static void testEstimate(void) {
+    // The estimate matches the modeled time within 1%
+    Rig rig(3, 2);
+    CHECK(rig.begin());
+    drawSlide(*rig.display, 3);
+    MAX3000_TimeEstimate estimate;
+    rig.display->estimateDisplayTime(estimate);
+    rig.display->display();
+    double modeledUs = rig.sim.getFrameStats().totalNs / 1e3;
+    CHECK(estimate.totalUs > modeledUs * 0.99 && estimate.totalUs < modeledUs * 1.01);
+}
+
+static void testBoardOrders(void) {
+    // Every order with mixed orientations, on a wall wider than 255 pixels
+    static const uint8_t orientations[] = { MAX3000_ORIENT_UPRIGHT, MAX3000_ORIENT_MIRROR_X, MAX3000_ORIENT_MIRROR_Y,
+        MAX3000_ORIENT_ROTATE_180, MAX3000_ORIENT_UPRIGHT, MAX3000_ORIENT_MIRROR_Y, MAX3000_ORIENT_ROTATE_180,
+        MAX3000_ORIENT_MIRROR_X, MAX3000_ORIENT_UPRIGHT, MAX3000_ORIENT_MIRROR_X, MAX3000_ORIENT_MIRROR_Y,
+        MAX3000_ORIENT_ROTATE_180, MAX3000_ORIENT_UPRIGHT, MAX3000_ORIENT_MIRROR_Y, MAX3000_ORIENT_ROTATE_180,
+        MAX3000_ORIENT_MIRROR_X, MAX3000_ORIENT_UPRIGHT, MAX3000_ORIENT_MIRROR_X, MAX3000_ORIENT_MIRROR_Y,
+        MAX3000_ORIENT_ROTATE_180 };
+    for(uint8_t order = MAX3000_ORDER_ROW_MAJOR; order <= MAX3000_ORDER_COL_MAJOR_BOUNCE; ++order) {
+        for(uint8_t layout = MAX3000_LAYOUT_PAGED; layout <= MAX3000_LAYOUT_PANEL; ++layout) {
+            Rig rig(10, 2);
+            rig.config.boardOrder        = order;
+            rig.config.bufferLayout      = layout;
+            rig.config.boardOrientations = orientations;
+            CHECK(rig.begin());
+            for(int frame = 0; frame < 2; ++frame) {
+                drawSlide(*rig.display, frame);
+                rig.display->drawPixel(270, 30, MAX3000_INVERSE);
+                rig.display->display();
+                CHECK(rig.mismatches() == 0);
+                CHECK(rig.sim.getTotalStats().faults == 0);
+            }
+        }
+    }
+}
+
+static void testPanelVariants(void) {
+    // A short and narrow variant between standard panels, mounted upside down
+    static const uint8_t cols[] = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 17, 16, 19, 18 };
+    static const uint8_t rows[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    static const MAX3000_Panel small PROGMEM = MAX3000_makePanel(cols, rows, MAX3000_ORIENT_MIRROR_X);
+    static const MAX3000_Panel * const types[]    = { NULL, &small, NULL };
+    static const uint8_t orientations[]           = { MAX3000_ORIENT_UPRIGHT, MAX3000_ORIENT_ROTATE_180, MAX3000_ORIENT_UPRIGHT };
+    Rig rig(3, 1);
+    rig.config.panelTypes        = types;
+    rig.config.boardOrientations = orientations;
+    CHECK(rig.begin());
+    drawSlide(*rig.display, 1);
+    rig.display->display();
+    CHECK(rig.mismatches() == 0);
+    CHECK(rig.sim.getTotalStats().faults == 0);
+
+    // Pixels outside the variant are never pulsed
+    rig.sim.resetStats();
+    rig.display->drawPixel(PANEL_WIDTH + 25, 14, MAX3000_INVERSE);
+    rig.display->display();
+    CHECK(rig.sim.getTotalStats().pulses == 0);
+}
+
+/**
+ * Draws the same frames on a compile-time display and a begun rig configured
+ * alike, and checks they send the same pulses.
+ */
+template <class StaticDisplay>
+static void compareStatic(Rig & rig, StaticDisplay & display, MAX3000_SimTransport & staticSim) {
+    display.display(true);
+    staticSim.resetStats();
+    for(int frame = 0; frame < 3; ++frame) {
+        drawSlide(*rig.display, frame);
+        drawSlide(display, frame);
+        rig.display->drawPixel(frame, PANEL_HEIGHT + 3, MAX3000_INVERSE);
+        display.drawPixel(frame, PANEL_HEIGHT + 3, MAX3000_INVERSE);
+        rig.display->display();
+        display.display();
+        CHECK(countMismatches(staticSim, rig.config, display) == 0);
+    }
+    CHECK(staticSim.getTotalStats().pulses == rig.sim.getTotalStats().pulses);
+    CHECK(staticSim.getTotalStats().totalNs == rig.sim.getTotalStats().totalNs);
+    CHECK(staticSim.getTotalStats().faults == 0);
+}
+
+static void testStatic(void) {
+    // A compile-time display sends the same pulses as one sized at runtime
+    typedef MAX3000_Static<3 * PANEL_WIDTH, 2 * PANEL_HEIGHT, MAX3000_ORDER_COL_MAJOR_BOUNCE, MAX3000_LAYOUT_PANEL> PanelDisplay;
+    Rig panelRig(3, 2);
+    panelRig.config.boardOrder   = MAX3000_ORDER_COL_MAJOR_BOUNCE;
+    panelRig.config.bufferLayout = MAX3000_LAYOUT_PANEL;
+    MAX3000_SimTransport panelSim;
+    PanelDisplay * panelDisplay = new PanelDisplay(panelSim);
+    CHECK(panelRig.begin());
+    CHECK(panelDisplay->begin());
+    compareStatic(panelRig, *panelDisplay, panelSim);
+
+    // Calibrations are refused unless the display holds their state
+    MAX3000_Calibration calibration;
+    calibration.begin(6, 100);
+    calibration.setBankDurationUs(4, 1, 0, 240);
+    CHECK(!panelDisplay->setCalibration(&calibration));
+    CHECK(panelDisplay->setCalibration(NULL));
+    delete panelDisplay;
+
+    // Paged buffer with a transition order, a panel variant and a calibration
+    typedef MAX3000_Static<3 * PANEL_WIDTH, 2 * PANEL_HEIGHT, MAX3000_ORDER_ROW_MAJOR_BOUNCE, MAX3000_LAYOUT_PAGED,
+        MAX3000_BUFFER_SINGLE, true>
+        PagedDisplay;
+    static const uint8_t cols[] = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 17, 16, 19, 18 };
+    static const uint8_t rows[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    static const MAX3000_Panel small PROGMEM      = MAX3000_makePanel(cols, rows, MAX3000_ORIENT_MIRROR_X);
+    static const MAX3000_Panel * const types[]    = { NULL, NULL, NULL, NULL, &small, NULL };
+    Rig pagedRig(3, 2);
+    pagedRig.config.boardOrder = MAX3000_ORDER_ROW_MAJOR_BOUNCE;
+    pagedRig.config.panelTypes = types;
+    MAX3000_SimTransport pagedSim;
+    PagedDisplay * pagedDisplay = new PagedDisplay(pagedSim, NULL, types);
+    CHECK(pagedRig.begin());
+    CHECK(pagedDisplay->begin());
+    pagedRig.display->setScanOrder(MAX3000_SCAN_SPIRAL);
+    pagedDisplay->setScanOrder(MAX3000_SCAN_SPIRAL);
+    CHECK(pagedRig.display->setCalibration(&calibration));
+    CHECK(pagedDisplay->setCalibration(&calibration));
+    compareStatic(pagedRig, *pagedDisplay, pagedSim);
+    pagedRig.display->setCalibration(NULL);
+    pagedDisplay->setCalibration(NULL);
+    delete pagedDisplay;
+}
+
+/**
+ * Renders a panel of the display passed as context into a tile.
+ */
+static void renderTile(uint16_t panelX, uint16_t panelY, uint8_t * tile, void * context) {
+    MAX3000_Display * display = (MAX3000_Display *)context;
+    memset(tile, 0, PANEL_PENDING_BYTES);
+    for(uint8_t col = 0; col < PANEL_WIDTH; ++col) {
+        for(uint8_t row = 0; row < PANEL_HEIGHT; ++row) {
+            if(display->getPixel(panelX * PANEL_WIDTH + col, panelY * PANEL_HEIGHT + row)) {
+                tile[col + (row / 8) * PANEL_WIDTH] |= 1 << (row & 7);
+            }
+        }
+    }
+}
+
+static void testStream(void) {
+    // Streamed panels match a frame buffer drawn with the same frames
+    for(uint8_t store = MAX3000_STREAM_STATE; store <= MAX3000_STREAM_HASH; ++store) {
+        Rig rig(3, 2);
+        CHECK(rig.begin());
+        MAX3000_SimTransport streamSim;
+        MAX3000_Config streamConfig = rig.config;
+        streamConfig.transport      = &streamSim;
+        MAX3000_Stream stream(streamConfig, renderTile, rig.display, store, 2);
+        CHECK(stream.begin());
+        for(int frame = 0; frame < 3; ++frame) {
+            drawSlide(*rig.display, frame);
+            stream.display();
+            CHECK(countMismatches(streamSim, rig.config, *rig.display) == 0);
+        }
+        CHECK(streamSim.getTotalStats().faults == 0);
+    }
+}
+
+static void testCalibration(void) {
+    // One slow bank: a calibrated map flips it without slowing every pulse
+    MAX3000_SimTiming spi;
+    spi.spiWordNs = 2000;
+    uint64_t timeNs[2];
+    for(int calibrated = 0; calibrated < 2; ++calibrated) {
+        Rig rig(3, 2, spi);
+        CHECK(rig.begin());
+        rig.sim.setFlipThresholdUs(100);
+        rig.sim.setFlipThresholdUs(4, 1, 0, 240);
+        MAX3000_Calibration calibration;
+        calibration.begin(6, 100);
+        calibration.setBankDurationUs(4, 1, 0, 240);
+        rig.display->setPulseDurationUs(240);
+        CHECK(rig.display->setCalibration(calibrated ? &calibration : NULL));
+        for(int frame = 0; frame < 3; ++frame) {
+            drawSlide(*rig.display, frame);
+            rig.display->display();
+            CHECK(rig.mismatches() == 0);
+        }
+        CHECK(rig.sim.getTotalStats().weakPulses == 0);
+        timeNs[calibrated] = rig.sim.getTotalStats().totalNs;
+        rig.display->setCalibration(NULL);
+    }
+    CHECK(timeNs[1] < timeNs[0]);
+
+    // A map begun again for another chain is dropped before the next update
+    Rig plain(3, 2, spi), dropped(3, 2, spi);
+    Rig * rigs[2] = { &plain, &dropped };
+    MAX3000_Calibration calibration;
+    calibration.begin(6, 100);
+    for(int calibrated = 0; calibrated < 2; ++calibrated) {
+        CHECK(rigs[calibrated]->begin());
+        rigs[calibrated]->display->setPulseDurationUs(240);
+        rigs[calibrated]->sim.resetStats();
+    }
+    CHECK(dropped.display->setCalibration(&calibration));
+    calibration.begin(5, 100);
+    for(int calibrated = 0; calibrated < 2; ++calibrated) {
+        drawSlide(*rigs[calibrated]->display, 1);
+        rigs[calibrated]->display->display();
+        CHECK(rigs[calibrated]->mismatches() == 0);
+    }
+    CHECK(dropped.sim.getTotalStats().totalNs == plain.sim.getTotalStats().totalNs);
+}
+
+static void testEngine(void) {
+    // Frames submitted to the background thread are all shown or replaced
+    Rig rig(2, 1);
+    CHECK(rig.begin());
+    MAX3000_Engine engine(*rig.display);
+    CHECK(engine.start());
+    std::future<bool> last;
+    for(int frame = 0; frame < 4; ++frame) {
+        drawSlide(*rig.display, frame);
+        last = engine.submit();
+    }
+    CHECK(last.get());
+    engine.stop();
+    CHECK(rig.mismatches() == 0);
+}
+
+static void testWall(void) {
+    // Two chains of a wall, updated on their own threads
+    MAX3000_Wall wall(3 * PANEL_WIDTH, 2 * PANEL_HEIGHT);
+    Rig top(3, 1), bottom(3, 1);
+    CHECK(top.begin() && bottom.begin());
+    CHECK(wall.addChain(*top.display, 0, 0));
+    CHECK(wall.addChain(*bottom.display, 0, PANEL_HEIGHT));
+    CHECK(wall.start());
+    for(int frame = 0; frame < 3; ++frame) {
+        for(int16_t x = 0; x < wall.width(); ++x) {
+            for(int16_t y = 0; y < wall.height(); ++y) {
+                wall.drawPixel(x, y, ((x * (frame + 1) + y * (frame + 3)) % 7) < 3 ? MAX3000_LIGHT : MAX3000_DARK);
+            }
+        }
+        wall.display();
+        CHECK(countMismatches(top.sim, top.config, wall) == 0);
+        CHECK(countMismatches(bottom.sim, bottom.config, wall, 0, PANEL_HEIGHT) == 0);
+    }
+    wall.stop();
+}
+
+static void testScheduler(void) {
+    // Two displays interleaved from one thread
+    MAX3000_SimTiming spi;
+    spi.spiWordNs = 2000;
+    Rig first(2, 1, spi), second(2, 1, spi);
+    second.sim.shareClock(first.sim);
+    CHECK(first.begin() && second.begin());
+    MAX3000_Scheduler scheduler;
+    CHECK(scheduler.add(*first.display) && scheduler.add(*second.display));
+    for(int frame = 0; frame < 3; ++frame) {
+        drawSlide(*first.display, frame);
+        drawSlide(*second.display, frame + 2);
+        scheduler.display();
+        CHECK(first.mismatches() == 0);
+        CHECK(second.mismatches() == 0);
+    }
+    CHECK(first.sim.getTotalStats().faults == 0 && second.sim.getTotalStats().faults == 0);
+
+    // A display waiting for its frame period doesn't hold up the other
+    first.display->setFramePeriodUs(500000);
+    drawSlide(*first.display, 0);
+    uint64_t start = first.sim.getNowNs();
+    scheduler.display();
+    first.display->drawPixel(0, 0, MAX3000_INVERSE);
+    drawSlide(*second.display, 1);
+    scheduler.display();
+    CHECK(first.mismatches() == 0);
+    CHECK(second.mismatches() == 0);
+    CHECK(second.sim.getFrameStats().totalNs > first.sim.getFrameStats().totalNs);
+    CHECK(first.sim.getNowNs() - start <= 500000000ULL + first.sim.getFrameStats().totalNs + 1000);
+}
+
+int main(void) {
+    testTransport();
+    testPulseModes();
+    testPulseWindows();
+    testDirtyTracking();
+    testSteps();
+    testPacing();
+    testPlans();
+    testScanOrders();
+    testEstimate();
+    testBoardOrders();
+    testPanelVariants();
+    testStatic();
+    testStream();
+    testCalibration();
+    testEngine();
+    testWall();
+    testScheduler();
+
+    printf("%d failed checks\n", failures);
+    return failures ? 1 : 0;
+}